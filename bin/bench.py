@@ -0,0 +1,96 @@
+import os
+import sys
+import time
+import struct
+import tempfile
+import subprocess
+from glob import glob
+from run import read_tensor
+
+if len(sys.argv) < 3:
+    print('Usage: {} [connx path] [model path] [[request count]]'.format(sys.argv[0]))
+    sys.exit(0)
+
+CONNX = sys.argv[1]
+MODEL = sys.argv[2]
+COUNT = int(sys.argv[3]) if len(sys.argv) > 3 else 10
+
+def weight_bytes(model_path):
+    # Size of the initializer payloads (N_M.data files) except the header, not what a request copies
+    total = 0
+    for path in glob(os.path.join(model_path, '*_*.data')):
+        with open(path, 'rb') as io:
+            dtype, ndim = struct.unpack('=II', io.read(8))
+            total += os.path.getsize(path) - 8 - 4 * ndim
+
+    return total
+
+input_paths = glob(os.path.join(MODEL, 'test_data_set_0', 'input_*.data'))
+input_paths.sort()
+
+inputs = []
+for input_path in input_paths:
+    with open(input_path, 'rb') as io:
+        inputs.append(io.read())
+
+latencies = []
+
+# connx prints statistics of each run to stderr
+env = dict(os.environ, CONNX_STATS='1')
+stats = tempfile.TemporaryFile('w+')
+
+with subprocess.Popen([CONNX, MODEL], stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=stats, env=env) as proc:
+    for i in range(COUNT):
+        start = time.perf_counter()
+
+        try:
+            proc.stdin.write(struct.pack('=I', len(inputs)))
+            for data in inputs:
+                proc.stdin.write(data)
+            proc.stdin.flush()
+        except BrokenPipeError:
+            stats.seek(0)
+            print(stats.read(), end='')
+            print('connx is terminated while loading the model')
+            sys.exit(1)
+
+        count = struct.unpack('=i', proc.stdout.read(4))[0]
+        if count < 0:
+            print('Error code:', count)
+            sys.exit(1)
+
+        for j in range(count):
+            read_tensor(proc.stdout)
+
+        latencies.append(time.perf_counter() - start)
+
+    # Terminate the connx
+    proc.stdin.write(struct.pack('=i', -1))
+    proc.stdin.close()
+
+# The first request includes lazy initialization, report it separately
+first = latencies.pop(0)
+
+print('# Model:', MODEL)
+print('  requests:     {}'.format(COUNT))
+print('  weight bytes: {}'.format(weight_bytes(MODEL)))
+print('  first:        {:.3f} ms'.format(first * 1000))
+if len(latencies) > 0:
+    print('  mean:         {:.3f} ms'.format(sum(latencies) / len(latencies) * 1000))
+    print('  min:          {:.3f} ms'.format(min(latencies) * 1000))
+    print('  max:          {:.3f} ms'.format(max(latencies) * 1000))
+
+# Statistics of model loading and the last run
+stats.seek(0)
+lines = [line[len('STATS: '):] for line in stats.read().splitlines() if line.startswith('STATS: ')]
+loads = [line for line in lines if line.startswith('load ')]
+runs = [line for line in lines if not line.startswith('load ')]
+
+# Bytes which connx_Tensor_copy copied in each request, measured by connx
+copies = [int(line.split('copied ')[1].split(' ')[0]) for line in runs if 'copied ' in line]
+if len(copies) > 0:
+    print('  copied bytes: {} per request (max)'.format(max(copies)))
+if len(loads) > 0:
+    print('  ' + loads[0])
+if len(runs) > 0:
+    print('  ' + runs[-1])
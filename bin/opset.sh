@@ -14,7 +14,11 @@ EOF
 for NAME in $@
 do
 cat << EOF
-extern int ${NAME}(connx_Graph* graph, uint32_t output_count, uint32_t* outputs, uint32_t input_count, uint32_t* inputs, void** attributes);
+extern int ${NAME}(connx_Context* context, uint32_t output_count, uint32_t* outputs, uint32_t input_count, uint32_t* inputs, void** attributes, void* plan);
+extern int ${NAME}_prepare(connx_Graph* graph, connx_Node* node) __attribute__((weak)); // optional
+extern int ${NAME}_infer(connx_Graph* graph, connx_Node* node) __attribute__((weak));   // optional
+extern bool ${NAME}_can_fuse(connx_Graph* graph, connx_Node* node, connx_Node* next) __attribute__((weak)); // optional
+extern int ${NAME}_fuse(connx_Graph* graph, connx_Node* node, connx_Node* next) __attribute__((weak));       // optional
 EOF
 done
 
@@ -53,3 +57,67 @@ cat << EOF
     NULL
 };
 EOF
+
+# Write prepare functions, NULL if the operator doesn't have one
+cat << EOF
+
+CONNX_PREPARE connx_opset_prepares[] = {
+EOF
+
+for NAME in $@
+do
+cat << EOF
+    ${NAME}_prepare,
+EOF
+done
+cat << EOF
+    NULL
+};
+EOF
+
+# Write infer functions, NULL if the operator doesn't have one
+cat << EOF
+
+CONNX_INFER connx_opset_infers[] = {
+EOF
+
+for NAME in $@
+do
+cat << EOF
+    ${NAME}_infer,
+EOF
+done
+cat << EOF
+    NULL
+};
+EOF
+
+# Write fuse functions, NULL if the operator doesn't have them
+cat << EOF
+
+CONNX_CAN_FUSE connx_opset_can_fuses[] = {
+EOF
+
+for NAME in $@
+do
+cat << EOF
+    ${NAME}_can_fuse,
+EOF
+done
+cat << EOF
+    NULL
+};
+
+CONNX_FUSE connx_opset_fuses[] = {
+EOF
+
+for NAME in $@
+do
+cat << EOF
+    ${NAME}_fuse,
+EOF
+done
+cat << EOF
+    NULL
+};
+EOF
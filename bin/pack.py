@@ -0,0 +1,201 @@
+import os
+import sys
+import struct
+
+if len(sys.argv) < 2:
+    print('Usage: {} [model path] [[output path]]'.format(sys.argv[0]))
+    print('  Pack model.connx, N.text and N_M.data files into one binary model (model.bin by default)')
+    sys.exit(0)
+
+MODEL = sys.argv[1]
+OUTPUT = sys.argv[2] if len(sys.argv) > 2 else os.path.join(MODEL, 'model.bin')
+
+MAGIC = b'CONNXBIN'
+VERSION = 1
+DATA_ALIGNMENT = 64
+
+# Attribute types
+FLOAT = 1
+INT = 2
+STRING = 3
+FLOATS = 6
+INTS = 7
+STRINGS = 8
+
+class Tokenizer:
+    # Same rule as the parser of connx: tokens are separated by a space or a new line and
+    # a string is its length followed by the bytes
+    def __init__(self, path):
+        with open(path, 'rb') as io:
+            self.text = io.read()
+        self.pos = 0
+
+    def token(self):
+        start = self.pos
+        while self.text[self.pos:self.pos + 1] not in (b' ', b'\n'):
+            self.pos += 1
+        token = self.text[start:self.pos]
+        self.pos += 1
+        return token.decode()
+
+    def keyword(self, keyword):
+        token = self.token()
+        if token != keyword:
+            raise Exception('Illegal syntax: {} != {}'.format(token, keyword))
+
+    def integer(self):
+        return int(self.token(), 0)
+
+    def float(self):
+        return float(self.token())
+
+    def string(self):
+        length = self.integer()
+        string = self.text[self.pos:self.pos + length]
+        self.pos += length + 1
+        return string
+
+class Writer:
+    def __init__(self):
+        self.buf = bytearray()
+
+    def offset(self):
+        return len(self.buf)
+
+    def align(self, alignment):
+        self.buf += bytes(-len(self.buf) % alignment)
+
+    def reserve(self, size):
+        # Placeholder of a table which is filled after its items are written
+        self.align(4)
+        offset = len(self.buf)
+        self.buf += bytes(size)
+        return offset
+
+    def put(self, offset, fmt, *values):
+        struct.pack_into('<' + fmt, self.buf, offset, *values)
+
+    def write(self, data, alignment=4):
+        self.align(alignment)
+        offset = len(self.buf)
+        self.buf += data
+        return offset
+
+    def words(self, fmt, values):
+        return self.write(struct.pack('<{}{}'.format(len(values), fmt), *values))
+
+    def string(self, string):
+        return self.write(string + b'\0', 1)
+
+def parse_model(writer):
+    tokenizer = Tokenizer(os.path.join(MODEL, 'model.connx'))
+
+    tokenizer.keyword('connx')
+    version = tokenizer.integer()
+
+    tokenizer.keyword('opset_import')
+    opsets = []
+    for i in range(tokenizer.integer()):
+        opsets.append((tokenizer.string(), tokenizer.integer()))
+
+    tokenizer.keyword('graph')
+    graph_count = tokenizer.integer()
+
+    return version, opsets, graph_count
+
+def pack_attribute(tokenizer):
+    tokenizer.string() # Drop name
+    type = tokenizer.integer()
+
+    if type == FLOAT:
+        return type, struct.pack('<f', tokenizer.float())
+    elif type == INT:
+        return type, struct.pack('<i', tokenizer.integer())
+    elif type == STRING:
+        return type, tokenizer.string() + b'\0'
+    elif type == FLOATS:
+        count = tokenizer.integer()
+        return type, struct.pack('<I{}f'.format(count), count, *[tokenizer.float() for i in range(count)])
+    elif type == INTS:
+        count = tokenizer.integer()
+        return type, struct.pack('<I{}i'.format(count), count, *[tokenizer.integer() for i in range(count)])
+    elif type == STRINGS:
+        count = tokenizer.integer()
+        return type, struct.pack('<I', count) + b''.join([tokenizer.string() + b'\0' for i in range(count)])
+    else:
+        raise Exception('Attribute type {} is not supported.'.format(type))
+
+def pack_initializer(writer, graph_id, initializer_id):
+    with open(os.path.join(MODEL, '{}_{}.data'.format(graph_id, initializer_id)), 'rb') as io:
+        dtype, ndim = struct.unpack('<II', io.read(8))
+        shape = io.read(4 * ndim)
+        data = io.read()
+
+    shape_offset = writer.write(shape)
+    data_offset = writer.write(data, DATA_ALIGNMENT)
+
+    return dtype, ndim, shape_offset, data_offset
+
+def pack_graph(writer, graph_id, graph_offset):
+    tokenizer = Tokenizer(os.path.join(MODEL, '{}.text'.format(graph_id)))
+
+    tokenizer.keyword('value_info')
+    value_info_count = tokenizer.integer()
+
+    tokenizer.keyword('initializer')
+    initializer_count = tokenizer.integer()
+    initializer_offset = writer.reserve(16 * initializer_count)
+    for i in range(initializer_count):
+        writer.put(initializer_offset + 16 * i, 'IIII', *pack_initializer(writer, graph_id, i + 1))
+
+    tokenizer.keyword('output')
+    output_count = tokenizer.integer()
+    output_offset = writer.words('I', [tokenizer.integer() for i in range(output_count)])
+
+    tokenizer.keyword('input')
+    input_count = tokenizer.integer()
+    input_offset = writer.words('I', [tokenizer.integer() for i in range(input_count)])
+
+    tokenizer.keyword('node')
+    node_count = tokenizer.integer()
+    node_offset = writer.reserve(28 * node_count)
+    for i in range(node_count):
+        op_type = tokenizer.token().encode()
+        output_count2 = tokenizer.integer()
+        input_count2 = tokenizer.integer()
+        attribute_count = tokenizer.integer()
+
+        outputs = [tokenizer.integer() for j in range(output_count2)]
+        inputs = [tokenizer.integer() for j in range(input_count2)]
+
+        attribute_offset = writer.reserve(12 * attribute_count)
+        for j in range(attribute_count):
+            type, data = pack_attribute(tokenizer)
+            writer.put(attribute_offset + 12 * j, 'III', type, len(data), writer.write(data))
+
+        writer.put(node_offset + 28 * i, 'IIIIIII', writer.string(op_type), output_count2, input_count2,
+                   attribute_count, writer.words('I', outputs), writer.words('I', inputs), attribute_offset)
+
+    writer.put(graph_offset, 'IIIIIIIII', value_info_count, initializer_count, initializer_offset,
+               output_count, output_offset, input_count, input_offset, node_count, node_offset)
+
+writer = Writer()
+version, opsets, graph_count = parse_model(writer)
+
+# header
+header_offset = writer.reserve(32)
+
+opset_offset = writer.reserve(8 * len(opsets))
+for i, (name, opset_version) in enumerate(opsets):
+    writer.put(opset_offset + 8 * i, 'II', writer.string(name), opset_version)
+
+graph_offset = writer.reserve(36 * graph_count)
+for i in range(graph_count):
+    pack_graph(writer, i, graph_offset + 36 * i)
+
+writer.put(header_offset, '8sIiIIII', MAGIC, VERSION, version, len(opsets), opset_offset, graph_count, graph_offset)
+
+with open(OUTPUT, 'wb') as io:
+    io.write(writer.buf)
+
+print('{}: {} bytes'.format(OUTPUT, writer.offset()))
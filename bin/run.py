@@ -45,43 +45,47 @@ def product(shape):
 
     return p
 
-def run_direct(connx_path, model_path, input_paths):
+def run_direct(connx_path, model_path, input_paths, count=1):
     with subprocess.Popen([connx_path, model_path], stdin=subprocess.PIPE, stdout=subprocess.PIPE) as proc:
-        # Write number of inputs
-        proc.stdin.write(struct.pack('=I', len(input_paths)))
+        # Run the model count times, the outputs of the last run are returned
+        for run in range(count):
+            # Write number of inputs
+            proc.stdin.write(struct.pack('=I', len(input_paths)))
+
+            for input_path in input_paths:
+                # Write data
+                with open(input_path, 'rb') as file:
+                    data = file.read()
+                    proc.stdin.write(data)
 
-        for input_path in input_paths:
-            # Write data
-            with open(input_path, 'rb') as file:
-                data = file.read()
-                proc.stdin.write(data)
+            proc.stdin.flush()
 
-        # Terminate the connx at next loop
-        proc.stdin.write(struct.pack('=i', -1))
-        proc.stdin.close()
+            # Parse number of outputs
+            output_count = struct.unpack('=i', proc.stdout.read(4))[0]
+            if output_count < 0:
+                print('Error code:', output_count)
+                return output_count
 
-        # Parse number of outputs
-        count = struct.unpack('=i', proc.stdout.read(4))[0]
-        if count < 0:
-            print('Error code:', count)
-            return count
+            outputs = [ ]
 
-        outputs = [ ]
+            for i in range(output_count):
+                # Parse data type
+                dtype, ndim = struct.unpack('=II', proc.stdout.read(8))
 
-        for i in range(count):
-            # Parse data type
-            dtype, ndim = struct.unpack('=II', proc.stdout.read(8))
-
-            shape = []
-            for i in range(ndim):
-                shape.append(struct.unpack('=I', proc.stdout.read(4))[0])
-
-            # Parse data
-            dtype = get_numpy_dtype(dtype)
-            itemsize = np.dtype(dtype).itemsize
-            total = product(shape)
-            output = np.frombuffer(proc.stdout.read(itemsize * total), dtype=dtype, count=product(shape)).reshape(shape)
-            outputs.append(output)
+                shape = []
+                for i in range(ndim):
+                    shape.append(struct.unpack('=I', proc.stdout.read(4))[0])
+
+                # Parse data
+                dtype = get_numpy_dtype(dtype)
+                itemsize = np.dtype(dtype).itemsize
+                total = product(shape)
+                output = np.frombuffer(proc.stdout.read(itemsize * total), dtype=dtype, count=product(shape)).reshape(shape)
+                outputs.append(output)
+
+        # Terminate the connx at next loop
+        proc.stdin.write(struct.pack('=i', -1))
+        proc.stdin.close()
 
         proc.stdout.close()
 
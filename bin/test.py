@@ -1,12 +1,16 @@
 import os
 import sys
+import struct
+import tempfile
+import subprocess
 from pathlib import Path
 from glob import glob
 import numpy as np
 from run import run_direct, get_numpy_dtype, product, read_tensor
 
 if len(sys.argv) < 3:
-    print('Usage: {} [connx path] [connx home path] [[test case] ...]'.format(sys.argv[0]))
+    print('Usage: {} [connx path] [connx home path] [[--binary]] [[test case] ...]'.format(sys.argv[0]))
+    print('  --binary: pack each model into model.bin by bin/pack.py and run it by the binary loader')
     sys.exit(0)
 
 PASS = '\033[92m'
@@ -15,12 +19,76 @@ END = '\033[0m'
 
 CONNX = sys.argv[1]
 HOME = sys.argv[2]
+IS_BINARY = '--binary' in sys.argv[3:]
+CASES = [arg for arg in sys.argv[3:] if arg != '--binary']
+PACK = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'pack.py')
+CONNX_ILLEGAL_SYNTAX = 3
+
+def pack(model_path, binary_path):
+    subprocess.run([sys.executable, PACK, model_path, os.path.join(binary_path, 'model.bin')], check=True,
+                   stdout=subprocess.DEVNULL)
+
+# Attributes of the first graph in model.bin: (offset of the attribute entry, type, size, data offset)
+def binary_attributes(buf):
+    graph_offset = struct.unpack_from('<I', buf, 28)[0]
+    node_count, node_offset = struct.unpack_from('<II', buf, graph_offset + 28)
+
+    attributes = []
+    for i in range(node_count):
+        attribute_count, attribute_offset = struct.unpack_from('<IIIIIII', buf, node_offset + 28 * i)[3::3]
+        for j in range(attribute_count):
+            offset = attribute_offset + 12 * j
+            attributes.append((offset, *struct.unpack_from('<III', buf, offset)))
+
+    return attributes
+
+# Each attribute type of a packed model is broken once, connx must reject it without reading out of the payload
+def test_malformed(model_path):
+    with tempfile.TemporaryDirectory() as binary_path:
+        pack(model_path, binary_path)
+        with open(os.path.join(binary_path, 'model.bin'), 'rb') as io:
+            original = io.read()
+
+        breaks = {
+            1: lambda buf, offset, size, data: struct.pack_into('<I', buf, offset + 4, 0),         # FLOAT empty
+            2: lambda buf, offset, size, data: struct.pack_into('<I', buf, offset + 4, 0),         # INT empty
+            3: lambda buf, offset, size, data: struct.pack_into('<I', buf, offset + 4, size - 1),  # STRING without NUL
+            7: lambda buf, offset, size, data: struct.pack_into('<I', buf, data,                   # INTS overflow
+                                                                struct.unpack_from('<I', buf, data)[0] + 100000),
+        }
+
+        for type, name in ((1, 'FLOAT'), (2, 'INT'), (3, 'STRING'), (7, 'INTS')):
+            print('# Test: {} (malformed {})'.format(Path(model_path).name, name), end=' ', flush=True)
+
+            buf = bytearray(original)
+            offset, _, size, data = next(attr for attr in binary_attributes(buf) if attr[1] == type)
+            breaks[type](buf, offset, size, data)
+            with open(os.path.join(binary_path, 'model.bin'), 'wb') as io:
+                io.write(buf)
+
+            proc = subprocess.run([CONNX, binary_path], stdin=subprocess.DEVNULL, stdout=subprocess.DEVNULL,
+                                  stderr=subprocess.PIPE)
+            if proc.returncode == CONNX_ILLEGAL_SYNTAX and b'Sanitizer' not in proc.stderr:
+                print(f'{PASS}Passed{END}')
+            else:
+                print(f'{FAIL}Failed{END}')
+                print('  exit code {}, {} is expected'.format(proc.returncode, CONNX_ILLEGAL_SYNTAX))
+                print(proc.stderr.decode(errors='replace'))
+
+def run_model(model_path, input_paths):
+    if not IS_BINARY:
+        return run_direct(CONNX, model_path, input_paths, 2)
+
+    # model.bin is preferred to the text model, so it is packed into a directory of its own
+    with tempfile.TemporaryDirectory() as binary_path:
+        pack(model_path, binary_path)
+        return run_direct(CONNX, binary_path, input_paths, 2)
 
 for path in Path(HOME + '/test').rglob('*.connx'):
-    if len(sys.argv) > 3:
+    if len(CASES) > 0:
         is_found = False
 
-        for tc in sys.argv[3:]:
+        for tc in CASES:
             if tc in str(path):
                 is_found = True
                 break
@@ -40,7 +108,8 @@ for path in Path(HOME + '/test').rglob('*.connx'):
         print('# Test:', name, end=' ', flush=True)
         model_path = os.path.join(path.parent)
 
-        outputs = run_direct(CONNX, model_path, input_paths)
+        # Run twice, the second run uses the memory plan made by the first one
+        outputs = run_model(model_path, input_paths)
 
         is_passed = True
 
@@ -72,3 +141,6 @@ for path in Path(HOME + '/test').rglob('*.connx'):
 
         if is_passed:
             print(f'{PASS}Passed{END}')
+
+if IS_BINARY and (len(CASES) == 0 or any(tc in 'test_conv_epilogue' for tc in CASES)):
+    test_malformed(os.path.join(HOME, 'test', 'data', 'graph', 'test_conv_epilogue'))
@@ -3,6 +3,8 @@
 
 #include <connx/types.h>
 
+void connx_accel_init(); // select the kernels for the processor, called by connx_init
+
 #define DEFINE_BASIC(NAME, TYPE)                                                       \
     void connx_##NAME##_add(int32_t count, TYPE* c, TYPE* a, TYPE* b);                 \
     void connx_##NAME##_sub(int32_t count, TYPE* c, TYPE* a, TYPE* b);                 \
@@ -29,4 +31,29 @@ DEFINE_BASIC(Bool, bool)
 DEFINE_BASIC(Complex64, void*)
 DEFINE_BASIC(Complex128, void*)
 
+// y = f(x) elementwise, y may be x. The error bounds of Float32 are in accel.c of the port
+#define DEFINE_FLOAT(NAME, TYPE)                                                                     \
+    void connx_##NAME##_exp(int32_t count, TYPE* y, TYPE* x);                                        \
+    void connx_##NAME##_log(int32_t count, TYPE* y, TYPE* x);                                        \
+    void connx_##NAME##_tanh(int32_t count, TYPE* y, TYPE* x);                                       \
+    void connx_##NAME##_sigmoid(int32_t count, TYPE* y, TYPE* x); /* 1 / (1 + e^-x) */               \
+    void connx_##NAME##_asin(int32_t count, TYPE* y, TYPE* x);                                       \
+    void connx_##NAME##_mish(int32_t count, TYPE* y, TYPE* x); /* x * tanh(ln(1 + e^x)) */
+
+DEFINE_FLOAT(Float32, float32_t)
+DEFINE_FLOAT(Float64, float64_t)
+
+// C = A * B where A is M x K, B is K x N and lda, ldb and ldc are the distances of the rows, returns CONNX_OK or
+// CONNX_NOT_ENOUGH_MEMORY
+#define DEFINE_GEMM(NAME, TYPE)                                                                                  \
+    int connx_##NAME##_gemm(int32_t M, int32_t N, int32_t K, TYPE* A, int32_t lda, TYPE* B, int32_t ldb, TYPE* C, \
+                            int32_t ldc);
+
+DEFINE_GEMM(Uint32, uint32_t)
+DEFINE_GEMM(Int32, int32_t)
+DEFINE_GEMM(Uint64, uint64_t)
+DEFINE_GEMM(Int64, int64_t)
+DEFINE_GEMM(Float32, float32_t)
+DEFINE_GEMM(Float64, float64_t)
+
 #endif /* __CONNX_ACCEL_H__ */
@@ -4,6 +4,7 @@
 #include <connx/tensor.h>
 
 typedef struct _connx_Graph connx_Graph;
+typedef struct _connx_Context connx_Context;
 
 typedef struct _connx_Model {
     int32_t version;
@@ -14,9 +15,24 @@ typedef struct _connx_Model {
 
     uint32_t graph_count;
     connx_Graph** graphs;
+
+    connx_Context* context; // default context of connx_Model_run
+
+    void* binary; // mapping of the binary model (model.bin), initializers point into it, NULL for the text model
+    uint32_t binary_size;
+
+    // Elapsed time of connx_Model_init by phase in microseconds
+    struct {
+        uint64_t model;       // parse model.connx or map model.bin
+        uint64_t graph;       // parse the graphs
+        uint64_t initializer; // load the initializers, overlapped with parsing the graphs
+        uint64_t wait;        // wait for the initializers after parsing the graphs
+        uint64_t analysis;    // prepare and optimize the nodes, count uses, build the DAG, plan the memory and infer types
+        uint64_t total;
+    } load_time;
 } connx_Model;
 
-typedef int (*CONNX_OPERATOR)(connx_Graph* graph, uint32_t output_count, uint32_t* outputs, uint32_t input_count, uint32_t* inputs, void** attributes);
+typedef int (*CONNX_OPERATOR)(connx_Context* context, uint32_t output_count, uint32_t* outputs, uint32_t input_count, uint32_t* inputs, void** attributes, void* plan);
 
 typedef struct _connx_Node {
     uint32_t output_count;
@@ -30,8 +46,42 @@ typedef struct _connx_Node {
 
     char* op_type;
     CONNX_OPERATOR op;
+    int (*infer)(connx_Graph* graph, struct _connx_Node* node); // NULL if the operator has no infer function
+    bool (*can_fuse)(connx_Graph* graph, struct _connx_Node* node, struct _connx_Node* next); // NULL if no fuse
+    int (*fuse)(connx_Graph* graph, struct _connx_Node* node, struct _connx_Node* next);      // NULL if no fuse
+
+    void* plan; // decoded attributes made by the prepare function of the operator, passed to op, or NULL
 } connx_Node;
 
+/**
+ * Optional prepare function of an operator (<op_type>_prepare), called once for each node when the model is loaded.
+ * It decodes the attributes into node->plan, so the operator only does the math on each run.
+ * The plan must be one block allocated by connx_alloc, it is freed with the graph.
+ */
+typedef int (*CONNX_PREPARE)(connx_Graph* graph, connx_Node* node);
+
+/**
+ * Optional infer function of an operator (<op_type>_infer) which sets the types of the outputs of a node from the
+ * types of its inputs (connx_Graph_get_value_info). It is called only when the types of all the inputs are known.
+ */
+typedef int (*CONNX_INFER)(connx_Graph* graph, connx_Node* node);
+
+/**
+ * Optional fuse functions of an operator which absorb next, the only consumer of the output of node, into node->plan.
+ * <op_type>_can_fuse returns whether next can be absorbed without changing anything, then <op_type>_fuse absorbs it,
+ * node produces the output of next and next is removed. They are called by connx_Graph_optimize after the nodes are
+ * prepared, an operator has both or none of them.
+ */
+typedef bool (*CONNX_CAN_FUSE)(connx_Graph* graph, connx_Node* node, connx_Node* next);
+typedef int (*CONNX_FUSE)(connx_Graph* graph, connx_Node* node, connx_Node* next);
+
+// Type of a value_info inferred before running
+typedef struct _connx_ValueInfo {
+    connx_DataType dtype; // CONNX_UNDEFINED if not known
+    int32_t ndim;
+    int32_t* shape;
+} connx_ValueInfo;
+
 typedef struct _connx_AttributeFloats {
     uint32_t count;
     float32_t array[0];
@@ -47,7 +97,45 @@ typedef struct _connx_AttributeStrings {
     char* array[0];
 } connx_AttributeStrings;
 
+// auto_pad attribute of Conv, MaxPool, ...
+typedef enum _connx_AutoPad {
+    CONNX_AUTO_PAD_NOTSET,
+    CONNX_AUTO_PAD_SAME_UPPER,
+    CONNX_AUTO_PAD_SAME_LOWER,
+    CONNX_AUTO_PAD_VALID,
+} connx_AutoPad;
 
+int connx_AutoPad_parse(char* auto_pad, connx_AutoPad* mode);
+
+// Copy count ints to array, or fill array with value if the attribute is empty (not given)
+int connx_AttributeInts_get(connx_AttributeInts* ints, uint32_t count, int32_t* array, int32_t value);
+
+// Activation memory plan
+typedef struct _connx_Plan {
+    uint32_t value_count;
+    uint32_t* roots;     // value_info which owns the buffer (Reshape shares its input's), 0 means not planned
+    int32_t* begins;     // index of the node which produces the value_info
+    uint32_t word_count; // length of a node set in words
+    uint32_t* frees;     // node set of each root, the nodes which run after the buffer is not used anymore
+    uint32_t* sizes;     // buffer size of each root observed while running
+    uint32_t* slots;     // buffer size of each root reserved in the arena
+    uint32_t* offsets;   // offset of each root in the arena
+    uint32_t* inplace_offsets; // inputs of node i which it may overwrite are inplaces[offsets[i]..offsets[i + 1]]
+    uint32_t* inplaces;        // in the order connx_Context_alloc_inplace tries them
+    uint32_t arena_size; // size of the planned arena
+    uint32_t total_size; // sum of the planned buffers, what it costs without reusing memory
+    uint32_t version;    // incremented whenever the plan is updated
+    bool is_dirty;       // sizes are changed since the last planning
+} connx_Plan;
+
+int connx_Plan_init(connx_Plan* plan, connx_Graph* graph);
+int connx_Plan_destroy(connx_Plan* plan);
+int connx_Plan_update(connx_Plan* plan);
+
+/**
+ * Graph is immutable while running, so a graph can be run by many contexts at the same time.
+ * Only the memory plan is updated by the contexts, guarded by the lock.
+ */
 struct _connx_Graph {
     connx_Model* model;
 
@@ -55,6 +143,8 @@ struct _connx_Graph {
 
     uint32_t initializer_count;
     connx_Tensor** initializers;
+    void** mappings;         // mapping of each initializer file which the initializer points into, or NULL
+    uint32_t* mapping_sizes;
     uint32_t input_count;
     uint32_t* inputs;
 
@@ -62,10 +152,45 @@ struct _connx_Graph {
     uint32_t* outputs;
 
     uint32_t value_info_count;
-    connx_Tensor** value_infos;
 
     uint32_t node_count;
     connx_Node** nodes;
+
+    uint32_t* use_counts; // number of consumers of each value_info
+
+    connx_ValueInfo* value_infos; // inferred type of each value_info, guarded by the lock
+    bool is_inferred;
+
+    // Dependency DAG of the nodes
+    uint32_t* dependency_counts; // number of nodes which produce the inputs of each node
+    uint32_t* successor_offsets; // successors of node i are successors[successor_offsets[i]..successor_offsets[i + 1]]
+    uint32_t* successors;
+    uint32_t width; // maximum number of nodes in a level of the DAG, how many nodes can run at the same time
+
+    connx_Plan plan;
+    connx_Lock lock;
+};
+
+/**
+ * Context holds the state of a run. Each thread must use its own context.
+ * Independent nodes of a run are executed by the workers of the thread pool at the same time, unless is_sequential.
+ */
+struct _connx_Context {
+    connx_Graph* graph;
+
+    connx_Tensor** value_infos;  // value slots
+    uint32_t* remain_counts;     // number of consumers which are not executed yet in the current run
+    uint32_t* dependency_counts; // number of predecessors of each node which are not executed yet in the current run
+    uint32_t live_bytes;         // bytes of the buffers alive in the current run
+    uint32_t peak_bytes;         // maximum of live_bytes in the last run
+    bool is_sequential;          // run the nodes one by one in the model order, for debugging
+
+    // Copy of the memory plan which is used in the current run
+    uint32_t plan_version;
+    uint32_t* slots;
+    uint32_t* offsets;
+    void* arena;
+    uint32_t arena_size;
 };
 
 int connx_Model_init(connx_Model* model);
@@ -73,12 +198,77 @@ int connx_Model_destroy(connx_Model* model);
 int connx_Model_run(connx_Model* model, uint32_t input_count, connx_Tensor** inputs, uint32_t* output_count,
                     connx_Tensor** outputs);
 
+int connx_Node_destroy(connx_Node* node);
+int connx_Node_set_op_type(connx_Graph* graph, connx_Node* node, char* op_type); // replace the operator and prepare it
+
 int connx_Graph_init(connx_Graph* graph, connx_Model* model, uint32_t graph_id);
 int connx_Graph_destroy(connx_Graph* graph);
-int connx_Graph_run(connx_Graph* graph, uint32_t input_count, connx_Tensor** inputs, uint32_t* output_count,
-                    connx_Tensor** outputs);
+int connx_Graph_optimize(connx_Graph* graph); // rewrite the graph before it is analyzed
+
+/**
+ * Infer the types of the value_infos from the types of the inputs and the initializers and reserve their buffers in
+ * the memory plan. Nothing is done if the inputs have the same types as the last inference.
+ */
+int connx_Graph_infer(connx_Graph* graph, uint32_t input_count, connx_Tensor** inputs);
+connx_ValueInfo* connx_Graph_get_value_info(connx_Graph* graph, uint32_t id); // NULL if not known
+int connx_Graph_set_value_info(connx_Graph* graph, uint32_t id, connx_DataType dtype, int32_t ndim, int32_t* shape);
+connx_Tensor* connx_Graph_get_constant(connx_Graph* graph, uint32_t id); // initializer of value_info id, or NULL
+
+// Infer function of elementwise operators, the output is the broadcast of the inputs
+int connx_infer_elementwise(connx_Graph* graph, connx_Node* node);
+
+/**
+ * Plan of the Elementwise operator, a group of elementwise nodes fused by connx_Graph_optimize. Register 0 to
+ * input_count - 1 are the inputs of the node and register input_count + i is the result of instructions[i], the last
+ * one is the output. All the instructions run on a block of elements before the next block, so the intermediate
+ * values stay in the cache.
+ */
+typedef enum _connx_ElementwiseOp {
+    CONNX_ELEMENTWISE_ADD,
+    CONNX_ELEMENTWISE_SUB,
+    CONNX_ELEMENTWISE_MUL,
+    CONNX_ELEMENTWISE_RELU,
+    CONNX_ELEMENTWISE_LEAKY_RELU, // floating point types only from here
+    CONNX_ELEMENTWISE_SIGMOID,
+    CONNX_ELEMENTWISE_ASIN,
+    CONNX_ELEMENTWISE_EXP,
+    CONNX_ELEMENTWISE_LOG,
+    CONNX_ELEMENTWISE_TANH,
+    CONNX_ELEMENTWISE_MISH,
+} connx_ElementwiseOp;
+
+typedef struct _connx_ElementwiseInstruction {
+    connx_ElementwiseOp op;
+    uint32_t a;      // register of the first operand
+    uint32_t b;      // register of the second operand of a binary operator
+    float32_t alpha; // of LeakyRelu
+} connx_ElementwiseInstruction;
+
+typedef struct _connx_ElementwisePlan {
+    uint32_t count;
+    connx_ElementwiseInstruction instructions[0];
+} connx_ElementwisePlan;
+
+int connx_Context_init(connx_Context* context, connx_Graph* graph);
+int connx_Context_destroy(connx_Context* context);
+int connx_Context_run(connx_Context* context, uint32_t input_count, connx_Tensor** inputs, uint32_t* output_count,
+                      connx_Tensor** outputs);
+
+connx_Tensor* connx_Context_get(connx_Context* context, uint32_t id);
+void connx_Context_set(connx_Context* context, uint32_t id, connx_Tensor* tensor);
+connx_Tensor* connx_Context_alloc(connx_Context* context, uint32_t id, connx_DataType dtype, int32_t ndim,
+                                  int32_t* shape);
+
+/**
+ * Allocate the output tensor of value_info id over the first input which the memory plan lets its node overwrite, has
+ * the same type and nothing else refers to, otherwise as connx_Context_alloc. Only for the operators
+ * which read the elements of the inputs before writing the output element of the same index.
+ */
+connx_Tensor* connx_Context_alloc_inplace(connx_Context* context, uint32_t id, connx_DataType dtype, int32_t ndim,
+                                          int32_t* shape);
 
-connx_Tensor* connx_Graph_get(connx_Graph* graph, uint32_t id);
-void connx_Graph_set(connx_Graph* graph, uint32_t id, connx_Tensor* tensor);
+// Run Add, Sub or Mul of op_type on inputs[0] and inputs[1] with the broadcast to outputs[0]
+int connx_run_binary(connx_Context* context, const char* op_type, connx_ElementwiseOp op, uint32_t* outputs,
+                     uint32_t* inputs);
 
 #endif /* __CONNX_CONNX_H__ */
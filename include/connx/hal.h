@@ -20,6 +20,13 @@ void connx_free(void* ptr);
 void* connx_load(const char* name);
 void connx_unload(void* buf);
 
+// Map the whole file read-only and start reading it ahead, returns NULL without error message if not found
+void* connx_map(const char* name, uint32_t* size);
+void connx_unmap(void* buf, uint32_t size);
+
+// Clock
+uint64_t connx_clock(); // monotonic time in microseconds
+
 // Tensor I/O
 int32_t connx_read(void* buf, int32_t size);
 int32_t connx_write(void* buf, int32_t size);
@@ -34,11 +41,20 @@ void connx_Lock_lock(connx_Lock* lock);
 void connx_Lock_unlock(connx_Lock* lock);
 
 // Thread pool
-typedef pthread_t connx_Thread;
+typedef uint32_t connx_Thread; // worker of the thread pool
+typedef void (*connx_Task)(void* context);
 
-uint32_t connx_Thread_alloc(uint32_t count, connx_Thread* threads);
+uint32_t connx_Thread_alloc(uint32_t count, connx_Thread* threads); // reserve idle workers, returns reserved count
 void connx_Thread_free(uint32_t count, connx_Thread* threads);
+void connx_Thread_run(connx_Thread thread, connx_Task task, void* context);
 void connx_Thread_join(uint32_t count, connx_Thread* threads);
+void connx_Thread_yield(); // give the processor to the other threads while waiting
+
+// Parallel loop
+// task is called with disjoint chunks [start, end) of [0, range) which are at least grain long (but the last one)
+typedef void (*connx_ParallelTask)(void* context, int32_t start, int32_t end);
+
+void connx_parallel_for(int32_t range, int32_t grain, connx_ParallelTask task, void* context);
 
 // debugging message
 void connx_debug(const char* format, ...);
@@ -5,5 +5,9 @@
 
 extern char* connx_opset_names[];
 extern CONNX_OPERATOR connx_opset_ops[];
+extern CONNX_PREPARE connx_opset_prepares[];
+extern CONNX_INFER connx_opset_infers[];
+extern CONNX_CAN_FUSE connx_opset_can_fuses[];
+extern CONNX_FUSE connx_opset_fuses[];
 
 #endif /* __CONNX_OPSET_H__ */
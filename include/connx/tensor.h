@@ -35,7 +35,9 @@ int32_t connx_Iterator_size_tensor(connx_Tensor* tensor);
 connx_Tensor* connx_Tensor_alloc(connx_DataType dtype, int32_t ndim, int32_t* shape);
 connx_Tensor* connx_Tensor_alloc_like(connx_Tensor* tensor);
 connx_Tensor* connx_Tensor_alloc_buffer(void* buf);
+connx_Tensor* connx_Tensor_wrap(connx_DataType dtype, int32_t ndim, int32_t* shape, void* buffer);
 connx_Tensor* connx_Tensor_copy(connx_Tensor* tensor);
+uint64_t connx_Tensor_copied_bytes(); // total bytes copied by connx_Tensor_copy
 connx_Tensor* connx_Tensor_reshape(connx_Tensor* tensor, int32_t ndim, int32_t* shape);
 
 void connx_Tensor_ref(connx_Tensor* tensor);
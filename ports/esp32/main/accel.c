@@ -1,7 +1,13 @@
 #include <string.h>
+#include <tgmath.h>
 #include <connx/accel.h>
+#include <connx/hal.h>
 #include <float.h>
 
+// The portable kernels are used on ESP32, which has no SIMD unit to select
+void connx_accel_init() {
+}
+
 #define CONNX_INT8_MIN INT8_MIN
 #define CONNX_INT8_MAX INT8_MAX
 #define CONNX_INT16_MIN INT16_MIN
@@ -115,4 +121,202 @@ TEMPLATE_TYPE connx_TEMPLATE_NAME_product(int32_t count, TEMPLATE_TYPE* array) {
 }
 TEMPLATE_END()
 
+// Activations
+TEMPLATE_START(FLOAT32, FLOAT64)
+#undef TEMPLATE_TYPE
+#define TEMPLATE_TYPE float32_t
+#undef TEMPLATE_NAME
+#define TEMPLATE_NAME Float32
+
+// ESP32 has a single precision FPU and no SIMD unit, the functions of libm in the precision of the type are used
+void connx_TEMPLATE_NAME_exp(int32_t count, TEMPLATE_TYPE* y, TEMPLATE_TYPE* x) {
+    for(int32_t i = 0; i < count; i++) {
+        y[i] = exp(x[i]);
+    }
+}
+
+void connx_TEMPLATE_NAME_log(int32_t count, TEMPLATE_TYPE* y, TEMPLATE_TYPE* x) {
+    for(int32_t i = 0; i < count; i++) {
+        y[i] = log(x[i]);
+    }
+}
+
+void connx_TEMPLATE_NAME_tanh(int32_t count, TEMPLATE_TYPE* y, TEMPLATE_TYPE* x) {
+    for(int32_t i = 0; i < count; i++) {
+        y[i] = tanh(x[i]);
+    }
+}
+
+void connx_TEMPLATE_NAME_sigmoid(int32_t count, TEMPLATE_TYPE* y, TEMPLATE_TYPE* x) {
+    for(int32_t i = 0; i < count; i++) {
+        y[i] = 1 / (1 + exp(-x[i]));
+    }
+}
+
+void connx_TEMPLATE_NAME_asin(int32_t count, TEMPLATE_TYPE* y, TEMPLATE_TYPE* x) {
+    for(int32_t i = 0; i < count; i++) {
+        y[i] = asin(x[i]);
+    }
+}
+
+/**
+ * tanh(ln(1 + e^x)) = n / (n + 2) where n = e^x * (e^x + 2), so it takes one exp and no log. x is clamped to 20 where
+ * the ratio is already 1 in float, so e^x never overflows. It doesn't lose precision for a negative x as log(1 + e^x)
+ * does.
+ */
+void connx_TEMPLATE_NAME_mish(int32_t count, TEMPLATE_TYPE* y, TEMPLATE_TYPE* x) {
+    for(int32_t i = 0; i < count; i++) {
+        TEMPLATE_TYPE e = exp(x[i] < 20 ? x[i] : 20);
+        TEMPLATE_TYPE n = e * (e + 2);
+        y[i] = x[i] * n / (n + 2);
+    }
+}
+TEMPLATE_END()
+
+/**
+ * GEMM
+ *
+ * Blocks of GEMM_KC rows and GEMM_NC columns of B and blocks of GEMM_MC rows of A are packed into panels, GEMM_NR
+ * columns of B or GEMM_MR rows of A which are ordered along K, so the micro kernel reads both of them in a row. A
+ * panel of B stays in L1 cache while it is multiplied by the panels of the block of A, which stays in L2 cache. The
+ * micro kernel keeps a GEMM_MR x GEMM_NR block of C in the registers over the packed K. The panels on the edges are
+ * padded with 0.
+ */
+#define GEMM_MR 4
+#define GEMM_NR(TYPE) (32 / sizeof(TYPE)) // two 16 bytes vectors
+#define GEMM_MC 64
+#define GEMM_KC 128
+#define GEMM_NC 256
+
+TEMPLATE_START(UINT32, INT32, UINT64, INT64, FLOAT32, FLOAT64)
+#undef TEMPLATE_TYPE
+#define TEMPLATE_TYPE float32_t
+#undef TEMPLATE_NAME
+#define TEMPLATE_NAME Float32
+
+static void pack_TEMPLATE_NAME_A(int32_t m, int32_t k, TEMPLATE_TYPE* A, int32_t lda, TEMPLATE_TYPE* packed) {
+    for(int32_t i0 = 0; i0 < m; i0 += GEMM_MR) {
+        int32_t rows = m - i0 < GEMM_MR ? m - i0 : GEMM_MR;
+
+        for(int32_t p = 0; p < k; p++) {
+            for(int32_t i = 0; i < GEMM_MR; i++) {
+                *packed++ = i < rows ? A[(i0 + i) * lda + p] : 0;
+            }
+        }
+    }
+}
+
+static void pack_TEMPLATE_NAME_B(int32_t k, int32_t n, TEMPLATE_TYPE* B, int32_t ldb, TEMPLATE_TYPE* packed) {
+    int32_t nr = GEMM_NR(TEMPLATE_TYPE);
+
+    for(int32_t j0 = 0; j0 < n; j0 += nr) {
+        int32_t cols = n - j0 < nr ? n - j0 : nr;
+
+        for(int32_t p = 0; p < k; p++) {
+            TEMPLATE_TYPE* b = B + p * ldb + j0;
+
+            if(cols == nr) {
+                memcpy(packed, b, sizeof(TEMPLATE_TYPE) * nr);
+            } else {
+                memset(packed, 0, sizeof(TEMPLATE_TYPE) * nr);
+                memcpy(packed, b, sizeof(TEMPLATE_TYPE) * cols);
+            }
+            packed += nr;
+        }
+    }
+}
+
+// C += a * b, or C = a * b if is_first, of a panel of A and a panel of B, rows x cols of C are written
+static void kernel_TEMPLATE_NAME(int32_t k, TEMPLATE_TYPE* a, TEMPLATE_TYPE* b, TEMPLATE_TYPE* C, int32_t ldc,
+                                 int32_t rows, int32_t cols, bool is_first) {
+    TEMPLATE_TYPE c[GEMM_MR][GEMM_NR(TEMPLATE_TYPE)];
+    memset(c, 0, sizeof(c));
+
+    for(int32_t p = 0; p < k; p++) {
+        for(int32_t i = 0; i < GEMM_MR; i++) {
+            TEMPLATE_TYPE a_i = a[p * GEMM_MR + i];
+
+            for(uint32_t j = 0; j < GEMM_NR(TEMPLATE_TYPE); j++) {
+                c[i][j] += a_i * b[p * GEMM_NR(TEMPLATE_TYPE) + j];
+            }
+        }
+    }
+
+    for(int32_t i = 0; i < rows; i++) {
+        TEMPLATE_TYPE* y = C + i * ldc;
+
+        if(is_first) {
+            memcpy(y, c[i], sizeof(TEMPLATE_TYPE) * cols);
+        } else {
+            for(int32_t j = 0; j < cols; j++) {
+                y[j] += c[i][j];
+            }
+        }
+    }
+}
+
+int connx_TEMPLATE_NAME_gemm(int32_t M, int32_t N, int32_t K, TEMPLATE_TYPE* A, int32_t lda, TEMPLATE_TYPE* B,
+                             int32_t ldb, TEMPLATE_TYPE* C, int32_t ldc) {
+    int32_t nr = GEMM_NR(TEMPLATE_TYPE);
+
+    // A few rows don't pay for the packing, the rows of B are added to the rows of C
+    if(M < GEMM_MR || K == 0) {
+        for(int32_t i = 0; i < M; i++) {
+            TEMPLATE_TYPE* y = C + i * ldc;
+            memset(y, 0, sizeof(TEMPLATE_TYPE) * N);
+
+            for(int32_t p = 0; p < K; p++) {
+                TEMPLATE_TYPE a = A[i * lda + p];
+                TEMPLATE_TYPE* b = B + p * ldb;
+
+                for(int32_t j = 0; j < N; j++) {
+                    y[j] += a * b[j];
+                }
+            }
+        }
+
+        return CONNX_OK;
+    }
+
+    int32_t mc_max = M < GEMM_MC ? (M + GEMM_MR - 1) / GEMM_MR * GEMM_MR : GEMM_MC;
+    int32_t kc_max = K < GEMM_KC ? K : GEMM_KC;
+    int32_t nc_max = N < GEMM_NC ? (N + nr - 1) / nr * nr : GEMM_NC;
+
+    TEMPLATE_TYPE* packed_A = connx_alloc(sizeof(TEMPLATE_TYPE) * (mc_max + nc_max) * kc_max);
+    if(packed_A == NULL) {
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+    TEMPLATE_TYPE* packed_B = packed_A + mc_max * kc_max;
+
+    for(int32_t j0 = 0; j0 < N; j0 += GEMM_NC) {
+        int32_t nc = N - j0 < GEMM_NC ? N - j0 : GEMM_NC;
+
+        for(int32_t p0 = 0; p0 < K; p0 += GEMM_KC) {
+            int32_t kc = K - p0 < GEMM_KC ? K - p0 : GEMM_KC;
+
+            pack_TEMPLATE_NAME_B(kc, nc, B + p0 * ldb + j0, ldb, packed_B);
+
+            for(int32_t i0 = 0; i0 < M; i0 += GEMM_MC) {
+                int32_t mc = M - i0 < GEMM_MC ? M - i0 : GEMM_MC;
+
+                pack_TEMPLATE_NAME_A(mc, kc, A + i0 * lda + p0, lda, packed_A);
+
+                for(int32_t jr = 0; jr < nc; jr += nr) {
+                    for(int32_t ir = 0; ir < mc; ir += GEMM_MR) {
+                        kernel_TEMPLATE_NAME(kc, packed_A + ir * kc, packed_B + jr * kc,
+                                             C + (i0 + ir) * ldc + j0 + jr, ldc,
+                                             mc - ir < GEMM_MR ? mc - ir : GEMM_MR, nc - jr < nr ? nc - jr : nr,
+                                             p0 == 0);
+                    }
+                }
+            }
+        }
+    }
+
+    connx_free(packed_A);
+
+    return CONNX_OK;
+}
+TEMPLATE_END()
+
 // TODO: Implement basic function sfor STRING, BOOL, COMPLEX64, COMPLEX128
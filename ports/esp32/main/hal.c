@@ -14,9 +14,12 @@
 
 #include "esp_spiffs.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 // Lifecycle
 void connx_init() {
+    connx_accel_init();
+
     // SPIFFS
     esp_vfs_spiffs_conf_t conf = {
       .base_path = "/spiffs",
@@ -109,6 +112,33 @@ void connx_unload(__attribute__((unused)) void* buf) {
     free(buf);
 }
 
+// SPIFFS cannot map a file, the file is read into memory
+void* connx_map(const char* name, uint32_t* size) {
+    char path[128];
+    snprintf(path, 128, "/spiffs/%s", name);
+
+    struct stat st;
+    if(stat(path, &st) != 0) {
+        return NULL;
+    }
+
+    void* buf = connx_load(name);
+    if(buf != NULL) {
+        *size = st.st_size;
+    }
+
+    return buf;
+}
+
+void connx_unmap(void* buf, __attribute__((unused)) uint32_t size) {
+    free(buf);
+}
+
+// Clock
+uint64_t connx_clock() {
+    return esp_timer_get_time();
+}
+
 // Tensor I/O
 int32_t connx_read(void* buf, int32_t size) {
     return -1;
@@ -143,9 +173,22 @@ uint32_t connx_Thread_alloc(uint32_t count, connx_Thread* threads) {
 void connx_Thread_free(uint32_t count, connx_Thread* threads) {
 }
 
+void connx_Thread_run(connx_Thread thread, connx_Task task, void* context) {
+}
+
 void connx_Thread_join(uint32_t count, connx_Thread* threads) {
 }
 
+void connx_Thread_yield() {
+}
+
+// Parallel loop
+void connx_parallel_for(int32_t range, int32_t grain, connx_ParallelTask task, void* context) {
+    if(range > 0) {
+        task(context, 0, range);
+    }
+}
+
 // error
 void connx_debug(const char* format, ...) {
     va_list args;
@@ -1,5 +1,8 @@
+#include <stdlib.h> // getenv
 #include <string.h>
+#include <tgmath.h>
 #include <connx/accel.h>
+#include <connx/hal.h>
 #include <float.h>
 
 #define CONNX_INT8_MIN INT8_MIN
@@ -34,24 +37,6 @@ TEMPLATE_START(UINT8, INT8, UINT16, INT16, UINT32, INT32, UINT64, INT64, FLOAT16
 #define TEMPLATE_DTYPE_MAX CONNX_INT32_MAX
 #define TEMPLATE_DTYPE_MIN CONNX_INT32_MIN
 
-void connx_TEMPLATE_NAME_add(int32_t count, TEMPLATE_TYPE* c, TEMPLATE_TYPE* a, TEMPLATE_TYPE* b) {
-    for(int32_t i = 0; i < count; i++) {
-        c[i] = a[i] + b[i];
-    }
-}
-
-void connx_TEMPLATE_NAME_sub(int32_t count, TEMPLATE_TYPE* c, TEMPLATE_TYPE* a, TEMPLATE_TYPE* b) {
-    for(int32_t i = 0; i < count; i++) {
-        c[i] = a[i] - b[i];
-    }
-}
-
-void connx_TEMPLATE_NAME_mul(int32_t count, TEMPLATE_TYPE* c, TEMPLATE_TYPE* a, TEMPLATE_TYPE* b) {
-    for(int32_t i = 0; i < count; i++) {
-        c[i] = a[i] * b[i];
-    }
-}
-
 void connx_TEMPLATE_NAME_broadcast(int32_t y_count, TEMPLATE_TYPE* y, int32_t x_count, TEMPLATE_TYPE* x) {
     for(int32_t i = 0; i < y_count / x_count; i++) {
         memcpy(y + i, x, sizeof(TEMPLATE_TYPE) * x_count);
@@ -93,6 +78,32 @@ int32_t connx_TEMPLATE_NAME_argmin(int32_t count, TEMPLATE_TYPE* y, TEMPLATE_TYP
 
     return argmin;
 }
+TEMPLATE_END()
+
+// Arithmetics of the types which have no SIMD kernels
+TEMPLATE_START(UINT8, INT8, UINT16, INT16, FLOAT16)
+#undef TEMPLATE_TYPE
+#define TEMPLATE_TYPE int32_t
+#undef TEMPLATE_NAME
+#define TEMPLATE_NAME Int32
+
+void connx_TEMPLATE_NAME_add(int32_t count, TEMPLATE_TYPE* c, TEMPLATE_TYPE* a, TEMPLATE_TYPE* b) {
+    for(int32_t i = 0; i < count; i++) {
+        c[i] = a[i] + b[i];
+    }
+}
+
+void connx_TEMPLATE_NAME_sub(int32_t count, TEMPLATE_TYPE* c, TEMPLATE_TYPE* a, TEMPLATE_TYPE* b) {
+    for(int32_t i = 0; i < count; i++) {
+        c[i] = a[i] - b[i];
+    }
+}
+
+void connx_TEMPLATE_NAME_mul(int32_t count, TEMPLATE_TYPE* c, TEMPLATE_TYPE* a, TEMPLATE_TYPE* b) {
+    for(int32_t i = 0; i < count; i++) {
+        c[i] = a[i] * b[i];
+    }
+}
 
 TEMPLATE_TYPE connx_TEMPLATE_NAME_sum(int32_t count, TEMPLATE_TYPE* array) {
     TEMPLATE_TYPE result = 0;
@@ -115,4 +126,560 @@ TEMPLATE_TYPE connx_TEMPLATE_NAME_product(int32_t count, TEMPLATE_TYPE* array) {
 }
 TEMPLATE_END()
 
+/**
+ * SIMD kernels
+ *
+ * The kernels of the types which GEMM supports are written with the vector extension of GCC and stamped out by
+ * SIMD_KERNELS for each instruction set, a vector is WIDTH bytes. connx_accel_init picks the widest set which the
+ * processor supports by cpuid, once. The generic set of 16 bytes vectors is compiled for the baseline of the target,
+ * SSE2 on x86_64 and NEON on the 64 bits ARM of Raspberry Pi, and it is the default until connx_accel_init.
+ * CONNX_SIMD environment variable (generic, sse4, avx2 or avx512) limits the set for testing.
+ *
+ * GEMM is blocked by GEMM_KC rows and GEMM_NC columns of B and GEMM_MC rows of A which are packed into panels, nr
+ * columns of B or GEMM_MR rows of A ordered along K, so the micro kernel reads both of them in a row. A panel of B
+ * stays in L1 cache while it is multiplied by the panels of the block of A, which stays in L2 cache. The micro kernel
+ * keeps a GEMM_MR x nr block of C in the registers over the packed K, where nr is two vectors. The panels on the
+ * edges are padded with 0.
+ */
+#define GEMM_MR 4
+#define GEMM_MC 64
+#define GEMM_KC 128
+#define GEMM_NC 256
+
+#define SIMD_BINARY(ISA, TARGET, WIDTH, NAME, TYPE, OP_NAME, OP)                           \
+    TARGET static void NAME##_##OP_NAME##_##ISA(int32_t count, TYPE* c, TYPE* a, TYPE* b) { \
+        int32_t lanes = WIDTH / sizeof(TYPE);                                              \
+        int32_t i = 0;                                                                     \
+                                                                                           \
+        for(; i + lanes <= count; i += lanes) {                                            \
+            NAME##_##ISA##_vector x, y;                                                    \
+            memcpy(&x, a + i, WIDTH);                                                      \
+            memcpy(&y, b + i, WIDTH);                                                      \
+            x = x OP y;                                                                    \
+            memcpy(c + i, &x, WIDTH);                                                      \
+        }                                                                                  \
+                                                                                           \
+        for(; i < count; i++) {                                                            \
+            c[i] = a[i] OP b[i];                                                           \
+        }                                                                                  \
+    }
+
+#define SIMD_REDUCE(ISA, TARGET, WIDTH, NAME, TYPE, OP_NAME, OP, INIT)           \
+    TARGET static TYPE NAME##_##OP_NAME##_##ISA(int32_t count, TYPE* array) {    \
+        int32_t lanes = WIDTH / sizeof(TYPE);                                    \
+        int32_t i = 0;                                                           \
+        NAME##_##ISA##_vector v = (NAME##_##ISA##_vector){0} + (TYPE)INIT;        \
+                                                                                 \
+        for(; i + lanes <= count; i += lanes) {                                  \
+            NAME##_##ISA##_vector x;                                             \
+            memcpy(&x, array + i, WIDTH);                                        \
+            v = v OP x;                                                          \
+        }                                                                        \
+                                                                                 \
+        TYPE result = INIT;                                                      \
+        for(int32_t j = 0; j < lanes; j++) {                                     \
+            result = result OP v[j];                                             \
+        }                                                                        \
+                                                                                 \
+        for(; i < count; i++) {                                                  \
+            result = result OP array[i];                                         \
+        }                                                                        \
+                                                                                 \
+        return result;                                                           \
+    }
+
+// C += a * b, or C = a * b if is_first, of a panel of A and a panel of B, rows x cols of C are written
+#define SIMD_GEMM(ISA, TARGET, WIDTH, NAME, TYPE)                                                                  \
+    TARGET static void NAME##_gemm_##ISA(int32_t k, TYPE* a, TYPE* b, TYPE* C, int32_t ldc, int32_t rows,          \
+                                         int32_t cols, bool is_first) {                                           \
+        int32_t lanes = WIDTH / sizeof(TYPE);                                                                      \
+        NAME##_##ISA##_vector c[GEMM_MR][2];                                                                       \
+        memset(c, 0, sizeof(c));                                                                                   \
+                                                                                                                   \
+        for(int32_t p = 0; p < k; p++) {                                                                           \
+            NAME##_##ISA##_vector b0, b1;                                                                          \
+            memcpy(&b0, b + p * lanes * 2, WIDTH);                                                                 \
+            memcpy(&b1, b + p * lanes * 2 + lanes, WIDTH);                                                         \
+                                                                                                                   \
+            for(int32_t i = 0; i < GEMM_MR; i++) {                                                                 \
+                c[i][0] += b0 * a[p * GEMM_MR + i];                                                                \
+                c[i][1] += b1 * a[p * GEMM_MR + i];                                                                \
+            }                                                                                                      \
+        }                                                                                                          \
+                                                                                                                   \
+        TYPE y[GEMM_MR][WIDTH * 2 / sizeof(TYPE)];                                                                 \
+        memcpy(y, c, sizeof(y));                                                                                   \
+                                                                                                                   \
+        for(int32_t i = 0; i < rows; i++) {                                                                        \
+            if(is_first) {                                                                                         \
+                memcpy(C + i * ldc, y[i], sizeof(TYPE) * cols);                                                    \
+            } else {                                                                                               \
+                for(int32_t j = 0; j < cols; j++) {                                                                \
+                    C[i * ldc + j] += y[i][j];                                                                     \
+                }                                                                                                  \
+            }                                                                                                      \
+        }                                                                                                          \
+    }
+
+#define SIMD_KERNELS(ISA, TARGET, WIDTH, NAME, TYPE)                               \
+    typedef TYPE NAME##_##ISA##_vector __attribute__((vector_size(WIDTH)));        \
+    SIMD_BINARY(ISA, TARGET, WIDTH, NAME, TYPE, add, +)                            \
+    SIMD_BINARY(ISA, TARGET, WIDTH, NAME, TYPE, sub, -)                            \
+    SIMD_BINARY(ISA, TARGET, WIDTH, NAME, TYPE, mul, *)                            \
+    SIMD_REDUCE(ISA, TARGET, WIDTH, NAME, TYPE, sum, +, 0)                         \
+    SIMD_REDUCE(ISA, TARGET, WIDTH, NAME, TYPE, product, *, 1)                     \
+    SIMD_GEMM(ISA, TARGET, WIDTH, NAME, TYPE)
+
+#define SIMD_ALL_KERNELS(ISA, TARGET, WIDTH)              \
+    SIMD_KERNELS(ISA, TARGET, WIDTH, Uint32, uint32_t)    \
+    SIMD_KERNELS(ISA, TARGET, WIDTH, Int32, int32_t)      \
+    SIMD_KERNELS(ISA, TARGET, WIDTH, Uint64, uint64_t)    \
+    SIMD_KERNELS(ISA, TARGET, WIDTH, Int64, int64_t)      \
+    SIMD_KERNELS(ISA, TARGET, WIDTH, Float32, float32_t)  \
+    SIMD_KERNELS(ISA, TARGET, WIDTH, Float64, float64_t)
+
+SIMD_ALL_KERNELS(generic, , 16)
+
+#if defined(__x86_64__) || defined(__i386__)
+SIMD_ALL_KERNELS(sse4, __attribute__((target("sse4.2"))), 16)
+SIMD_ALL_KERNELS(avx2, __attribute__((target("avx2"))), 32)
+SIMD_ALL_KERNELS(avx512, __attribute__((target("avx512f"))), 64)
+#endif
+
+/**
+ * Transcendentals
+ *
+ * The Float32 functions are the polynomials of Cephes after the range reduction, written without branches so the loops
+ * over the arrays are vectorised for each instruction set like the kernels above. The selects are blended and sqrt is
+ * one instruction because the port is built with -fno-trapping-math and -fno-math-errno. The maximum errors over all
+ * the floats against libm in double are
+ *
+ *   exp      0.99 ulp, underflows to 0 below -103.97 and overflows to inf above 88.72
+ *   log      0.83 ulp, -inf for 0 and NaN for a negative x
+ *   tanh     1.33 ulp
+ *   sigmoid  2.40 ulp
+ *   asin     2.40 ulp, NaN outside of [-1, 1]
+ *
+ * and NaN is passed through. Float64 calls libm. CONNX_STRICT_LIBM=1 builds Float32 on libm in double too, the same as
+ * the reference, for the bit exact comparisons.
+ */
+static inline int32_t _bits(float32_t x) {
+    int32_t i;
+    memcpy(&i, &x, sizeof(i));
+    return i;
+}
+
+static inline float32_t _float(int32_t i) {
+    float32_t x;
+    memcpy(&x, &i, sizeof(x));
+    return x;
+}
+
+#ifdef CONNX_STRICT_LIBM
+static inline float32_t _exp_Float32(float32_t x) {
+    return exp((float64_t)x);
+}
+
+static inline float32_t _log_Float32(float32_t x) {
+    return log((float64_t)x);
+}
+
+static inline float32_t _tanh_Float32(float32_t x) {
+    return tanh((float64_t)x);
+}
+
+static inline float32_t _asin_Float32(float32_t x) {
+    return asin((float64_t)x);
+}
+#else
+// e^x = 2^n * e^r where n = round(x / ln 2) and |r| <= ln 2 / 2, 2^n is split into two factors for the denormals
+static inline float32_t _exp_Float32(float32_t x) {
+    x = x < -104.0f ? -104.0f : x;
+    x = x > 89.0f ? 89.0f : x;
+
+    // Adding 1.5 * 2^23 rounds to an integer which is also in the low bits
+    float32_t t = x * 1.44269504088896341f + 12582912.0f;
+    int32_t n = _bits(t) - _bits(12582912.0f);
+    float32_t f = t - 12582912.0f;
+    float32_t r = x - f * 0.693359375f + f * 2.12194440e-4f;
+
+    float32_t p = 1.9875691500e-4f;
+    p = p * r + 1.3981999507e-3f;
+    p = p * r + 8.3334519073e-3f;
+    p = p * r + 4.1665795894e-2f;
+    p = p * r + 1.6666665459e-1f;
+    p = p * r + 5.0000001201e-1f;
+    p = p * r * r + r + 1.0f;
+
+    int32_t half = n >> 1;
+    return p * _float((half + 127) << 23) * _float((n - half + 127) << 23);
+}
+
+// log x = e * ln 2 + log m where x = 2^e * m and sqrt(1/2) <= m < sqrt(2), the denormals are scaled by 2^23 first
+static inline float32_t _log_Float32(float32_t x) {
+    int32_t is_denormal = x < 1.17549435e-38f;
+    int32_t bits = _bits(is_denormal ? x * 8388608.0f : x);
+    int32_t e = ((bits >> 23) & 0xff) - (is_denormal ? 149 : 126);
+    float32_t m = _float((bits & 0x007fffff) | 0x3f000000);
+
+    float32_t is_small = m < 0.707106781186547524f ? 1.0f : 0.0f;
+    float32_t f = (float32_t)e - is_small;
+    m = m + m * is_small - 1.0f;
+
+    float32_t z = m * m;
+    float32_t p = 7.0376836292e-2f;
+    p = p * m - 1.1514610310e-1f;
+    p = p * m + 1.1676998740e-1f;
+    p = p * m - 1.2420140846e-1f;
+    p = p * m + 1.4249322787e-1f;
+    p = p * m - 1.6668057665e-1f;
+    p = p * m + 2.0000714765e-1f;
+    p = p * m - 2.4999993993e-1f;
+    p = p * m + 3.3333331174e-1f;
+    p = p * m * z - f * 2.12194440e-4f - 0.5f * z;
+    p = m + p + f * 0.693359375f;
+
+    p = x == INFINITY ? x : p;
+    p = x == 0 ? -INFINITY : p;
+    p = x < 0 ? NAN : p;
+    return x != x ? x : p;
+}
+
+// A polynomial near 0 where 1 - 2 / (e^2|x| + 1) cancels, tanh is 1 in float from 9
+static inline float32_t _tanh_Float32(float32_t x) {
+    float32_t a = x < 0 ? -x : x;
+
+    float32_t z = x * x;
+    float32_t p = -5.70498872745e-3f;
+    p = p * z + 2.06390887954e-2f;
+    p = p * z - 5.37397155531e-2f;
+    p = p * z + 1.33314422036e-1f;
+    p = p * z - 3.33332819422e-1f;
+    p = p * z * x + x;
+
+    float32_t q = 1 - 2 / (_exp_Float32(2 * (a < 9.0f ? a : 9.0f)) + 1);
+    q = x < 0 ? -q : q;
+
+    return a < 0.625f ? p : (x != x ? x : q);
+}
+
+// asin x = pi / 2 - 2 asin sqrt((1 - x) / 2) from 0.5
+static inline float32_t _asin_Float32(float32_t x) {
+    float32_t a = x < 0 ? -x : x;
+    int32_t is_large = a > 0.5f;
+
+    float32_t h = a < 1 ? 0.5f * (1 - a) : 0;
+    float32_t r = sqrt(h);
+    float32_t z = is_large ? h : a * a;
+    float32_t s = is_large ? r : a;
+
+    float32_t p = 4.2163199048e-2f;
+    p = p * z + 2.4181311049e-2f;
+    p = p * z + 4.5470025998e-2f;
+    p = p * z + 7.4953002686e-2f;
+    p = p * z + 1.6666752422e-1f;
+    p = p * z * s + s;
+    p = is_large ? 1.57079632679489662f - 2 * p : p;
+    p = a > 1 ? NAN : p;
+    return x < 0 ? -p : p;
+}
+#endif /* CONNX_STRICT_LIBM */
+
+static inline float32_t _sigmoid_Float32(float32_t x) {
+#ifdef CONNX_STRICT_LIBM
+    return 1 / (1 + exp(-(float64_t)x));
+#else
+    // e^-|x| never overflows, so it underflows gradually as exp does
+    float32_t e = _exp_Float32(x < 0 ? x : -x);
+    return x < 0 ? e / (1 + e) : 1 / (1 + e);
+#endif /* CONNX_STRICT_LIBM */
+}
+
+/**
+ * tanh(ln(1 + e^x)) = n / (n + 2) where n = e^x * (e^x + 2), so it takes one exp and no log. x is clamped to 20 where
+ * the ratio is already 1 in float, so e^x never overflows. It doesn't lose precision for a negative x as log(1 + e^x)
+ * does.
+ */
+static inline float32_t _mish_Float32(float32_t x) {
+    float32_t e = _exp_Float32(x < 20 ? x : 20);
+    float32_t n = e * (e + 2);
+    return x * n / (n + 2);
+}
+
+static inline float64_t _exp_Float64(float64_t x) {
+    return exp(x);
+}
+
+static inline float64_t _log_Float64(float64_t x) {
+    return log(x);
+}
+
+static inline float64_t _tanh_Float64(float64_t x) {
+    return tanh(x);
+}
+
+static inline float64_t _sigmoid_Float64(float64_t x) {
+    return 1 / (1 + exp(-x));
+}
+
+static inline float64_t _asin_Float64(float64_t x) {
+    return asin(x);
+}
+
+static inline float64_t _mish_Float64(float64_t x) {
+    float64_t e = exp(x < 20 ? x : 20);
+    float64_t n = e * (e + 2);
+    return x * n / (n + 2);
+}
+
+#define SIMD_UNARY(ISA, TARGET, NAME, TYPE, OP_NAME)                                        \
+    TARGET static void NAME##_##OP_NAME##_##ISA(int32_t count, TYPE* y, TYPE* x) {           \
+        for(int32_t i = 0; i < count; i++) {                                                \
+            y[i] = _##OP_NAME##_##NAME(x[i]);                                               \
+        }                                                                                   \
+    }
+
+#define SIMD_MATH(ISA, TARGET, NAME, TYPE)              \
+    SIMD_UNARY(ISA, TARGET, NAME, TYPE, exp)            \
+    SIMD_UNARY(ISA, TARGET, NAME, TYPE, log)            \
+    SIMD_UNARY(ISA, TARGET, NAME, TYPE, tanh)           \
+    SIMD_UNARY(ISA, TARGET, NAME, TYPE, sigmoid)        \
+    SIMD_UNARY(ISA, TARGET, NAME, TYPE, asin)           \
+    SIMD_UNARY(ISA, TARGET, NAME, TYPE, mish)
+
+SIMD_MATH(generic, , Float32, float32_t)
+SIMD_MATH(generic, , Float64, float64_t)
+
+#if defined(__x86_64__) || defined(__i386__)
+SIMD_MATH(sse4, __attribute__((target("sse4.2"))), Float32, float32_t)
+SIMD_MATH(avx2, __attribute__((target("avx2"))), Float32, float32_t)
+SIMD_MATH(avx512, __attribute__((target("avx512f"))), Float32, float32_t)
+#endif
+
+#define MATH_TABLE(NAME, TYPE)                                                                                 \
+    typedef struct _##NAME##Math {                                                                             \
+        void (*exp)(int32_t count, TYPE* y, TYPE* x);                                                          \
+        void (*log)(int32_t count, TYPE* y, TYPE* x);                                                          \
+        void (*tanh)(int32_t count, TYPE* y, TYPE* x);                                                         \
+        void (*sigmoid)(int32_t count, TYPE* y, TYPE* x);                                                      \
+        void (*asin)(int32_t count, TYPE* y, TYPE* x);                                                         \
+        void (*mish)(int32_t count, TYPE* y, TYPE* x);                                                         \
+    } NAME##Math;                                                                                              \
+                                                                                                               \
+    static NAME##Math NAME##_math = {NAME##_exp_generic,     NAME##_log_generic,  NAME##_tanh_generic,         \
+                                     NAME##_sigmoid_generic, NAME##_asin_generic, NAME##_mish_generic};
+
+MATH_TABLE(Float32, float32_t)
+MATH_TABLE(Float64, float64_t)
+
+// Kernels of a type which are selected by connx_accel_init
+#define SIMD_TABLE(NAME, TYPE)                                                                                 \
+    typedef struct _##NAME##Kernels {                                                                          \
+        void (*add)(int32_t count, TYPE* c, TYPE* a, TYPE* b);                                                 \
+        void (*sub)(int32_t count, TYPE* c, TYPE* a, TYPE* b);                                                 \
+        void (*mul)(int32_t count, TYPE* c, TYPE* a, TYPE* b);                                                 \
+        TYPE (*sum)(int32_t count, TYPE* array);                                                               \
+        TYPE (*product)(int32_t count, TYPE* array);                                                           \
+        void (*gemm)(int32_t k, TYPE* a, TYPE* b, TYPE* C, int32_t ldc, int32_t rows, int32_t cols, bool is_first); \
+        int32_t nr;                                                                                            \
+    } NAME##Kernels;                                                                                           \
+                                                                                                               \
+    static NAME##Kernels NAME##_kernels = {NAME##_add_generic, NAME##_sub_generic, NAME##_mul_generic,         \
+                                           NAME##_sum_generic, NAME##_product_generic, NAME##_gemm_generic,    \
+                                           16 * 2 / sizeof(TYPE)};
+
+SIMD_TABLE(Uint32, uint32_t)
+SIMD_TABLE(Int32, int32_t)
+SIMD_TABLE(Uint64, uint64_t)
+SIMD_TABLE(Int64, int64_t)
+SIMD_TABLE(Float32, float32_t)
+SIMD_TABLE(Float64, float64_t)
+
+#define SIMD_SELECT(ISA, WIDTH, NAME, TYPE)                                                                        \
+    NAME##_kernels = (NAME##Kernels){NAME##_add_##ISA,     NAME##_sub_##ISA,  NAME##_mul_##ISA, NAME##_sum_##ISA, \
+                                     NAME##_product_##ISA, NAME##_gemm_##ISA, WIDTH * 2 / sizeof(TYPE)};
+
+#define SIMD_SELECT_ALL(ISA, WIDTH)                  \
+    SIMD_SELECT(ISA, WIDTH, Uint32, uint32_t)        \
+    SIMD_SELECT(ISA, WIDTH, Int32, int32_t)          \
+    SIMD_SELECT(ISA, WIDTH, Uint64, uint64_t)        \
+    SIMD_SELECT(ISA, WIDTH, Int64, int64_t)          \
+    SIMD_SELECT(ISA, WIDTH, Float32, float32_t)      \
+    SIMD_SELECT(ISA, WIDTH, Float64, float64_t)      \
+    Float32_math = (Float32Math){Float32_exp_##ISA,     Float32_log_##ISA,  Float32_tanh_##ISA, \
+                                 Float32_sigmoid_##ISA, Float32_asin_##ISA, Float32_mish_##ISA};
+
+void connx_accel_init() {
+#if defined(__x86_64__) || defined(__i386__)
+    char* simd = getenv("CONNX_SIMD");
+    int level = 3;
+    if(simd != NULL) {
+        level = strcmp(simd, "avx512") == 0 ? 3 : strcmp(simd, "avx2") == 0 ? 2 : strcmp(simd, "sse4") == 0 ? 1 : 0;
+    }
+
+    __builtin_cpu_init();
+
+    if(level >= 3 && __builtin_cpu_supports("avx512f")) {
+        SIMD_SELECT_ALL(avx512, 64)
+    } else if(level >= 2 && __builtin_cpu_supports("avx2")) {
+        SIMD_SELECT_ALL(avx2, 32)
+    } else if(level >= 1 && __builtin_cpu_supports("sse4.2")) {
+        SIMD_SELECT_ALL(sse4, 16)
+    }
+#endif
+}
+
+TEMPLATE_START(UINT32, INT32, UINT64, INT64, FLOAT32, FLOAT64)
+#undef TEMPLATE_TYPE
+#define TEMPLATE_TYPE float32_t
+#undef TEMPLATE_NAME
+#define TEMPLATE_NAME Float32
+
+void connx_TEMPLATE_NAME_add(int32_t count, TEMPLATE_TYPE* c, TEMPLATE_TYPE* a, TEMPLATE_TYPE* b) {
+    TEMPLATE_NAME_kernels.add(count, c, a, b);
+}
+
+void connx_TEMPLATE_NAME_sub(int32_t count, TEMPLATE_TYPE* c, TEMPLATE_TYPE* a, TEMPLATE_TYPE* b) {
+    TEMPLATE_NAME_kernels.sub(count, c, a, b);
+}
+
+void connx_TEMPLATE_NAME_mul(int32_t count, TEMPLATE_TYPE* c, TEMPLATE_TYPE* a, TEMPLATE_TYPE* b) {
+    TEMPLATE_NAME_kernels.mul(count, c, a, b);
+}
+
+TEMPLATE_TYPE connx_TEMPLATE_NAME_sum(int32_t count, TEMPLATE_TYPE* array) {
+    return TEMPLATE_NAME_kernels.sum(count, array);
+}
+
+TEMPLATE_TYPE connx_TEMPLATE_NAME_product(int32_t count, TEMPLATE_TYPE* array) {
+    return TEMPLATE_NAME_kernels.product(count, array);
+}
+
+static void pack_TEMPLATE_NAME_A(int32_t m, int32_t k, TEMPLATE_TYPE* A, int32_t lda, TEMPLATE_TYPE* packed) {
+    for(int32_t i0 = 0; i0 < m; i0 += GEMM_MR) {
+        int32_t rows = m - i0 < GEMM_MR ? m - i0 : GEMM_MR;
+
+        for(int32_t p = 0; p < k; p++) {
+            for(int32_t i = 0; i < GEMM_MR; i++) {
+                *packed++ = i < rows ? A[(i0 + i) * lda + p] : 0;
+            }
+        }
+    }
+}
+
+static void pack_TEMPLATE_NAME_B(int32_t k, int32_t n, int32_t nr, TEMPLATE_TYPE* B, int32_t ldb,
+                                 TEMPLATE_TYPE* packed) {
+    for(int32_t j0 = 0; j0 < n; j0 += nr) {
+        int32_t cols = n - j0 < nr ? n - j0 : nr;
+
+        for(int32_t p = 0; p < k; p++) {
+            TEMPLATE_TYPE* b = B + p * ldb + j0;
+
+            if(cols == nr) {
+                memcpy(packed, b, sizeof(TEMPLATE_TYPE) * nr);
+            } else {
+                memset(packed, 0, sizeof(TEMPLATE_TYPE) * nr);
+                memcpy(packed, b, sizeof(TEMPLATE_TYPE) * cols);
+            }
+            packed += nr;
+        }
+    }
+}
+
+int connx_TEMPLATE_NAME_gemm(int32_t M, int32_t N, int32_t K, TEMPLATE_TYPE* A, int32_t lda, TEMPLATE_TYPE* B,
+                             int32_t ldb, TEMPLATE_TYPE* C, int32_t ldc) {
+    TEMPLATE_NAMEKernels* kernels = &TEMPLATE_NAME_kernels;
+    int32_t nr = kernels->nr;
+
+    // A few rows don't pay for the packing, the rows of B are added to the rows of C
+    if(M < GEMM_MR || K == 0) {
+        for(int32_t i = 0; i < M; i++) {
+            TEMPLATE_TYPE* y = C + i * ldc;
+            memset(y, 0, sizeof(TEMPLATE_TYPE) * N);
+
+            for(int32_t p = 0; p < K; p++) {
+                TEMPLATE_TYPE a = A[i * lda + p];
+                TEMPLATE_TYPE* b = B + p * ldb;
+
+                for(int32_t j = 0; j < N; j++) {
+                    y[j] += a * b[j];
+                }
+            }
+        }
+
+        return CONNX_OK;
+    }
+
+    int32_t mc_max = M < GEMM_MC ? (M + GEMM_MR - 1) / GEMM_MR * GEMM_MR : GEMM_MC;
+    int32_t kc_max = K < GEMM_KC ? K : GEMM_KC;
+    int32_t nc_max = (N < GEMM_NC ? N : GEMM_NC) + nr - 1;
+    nc_max -= nc_max % nr;
+
+    TEMPLATE_TYPE* packed_A = connx_alloc(sizeof(TEMPLATE_TYPE) * (mc_max + nc_max) * kc_max);
+    if(packed_A == NULL) {
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+    TEMPLATE_TYPE* packed_B = packed_A + mc_max * kc_max;
+
+    for(int32_t j0 = 0; j0 < N; j0 += GEMM_NC) {
+        int32_t nc = N - j0 < GEMM_NC ? N - j0 : GEMM_NC;
+
+        for(int32_t p0 = 0; p0 < K; p0 += GEMM_KC) {
+            int32_t kc = K - p0 < GEMM_KC ? K - p0 : GEMM_KC;
+
+            pack_TEMPLATE_NAME_B(kc, nc, nr, B + p0 * ldb + j0, ldb, packed_B);
+
+            for(int32_t i0 = 0; i0 < M; i0 += GEMM_MC) {
+                int32_t mc = M - i0 < GEMM_MC ? M - i0 : GEMM_MC;
+
+                pack_TEMPLATE_NAME_A(mc, kc, A + i0 * lda + p0, lda, packed_A);
+
+                for(int32_t jr = 0; jr < nc; jr += nr) {
+                    for(int32_t ir = 0; ir < mc; ir += GEMM_MR) {
+                        kernels->gemm(kc, packed_A + ir * kc, packed_B + jr * kc, C + (i0 + ir) * ldc + j0 + jr, ldc,
+                                      mc - ir < GEMM_MR ? mc - ir : GEMM_MR, nc - jr < nr ? nc - jr : nr, p0 == 0);
+                    }
+                }
+            }
+        }
+    }
+
+    connx_free(packed_A);
+
+    return CONNX_OK;
+}
+TEMPLATE_END()
+
+// Activations, the members are called in parentheses as exp, log, tanh and asin are macros of tgmath.h
+TEMPLATE_START(FLOAT32, FLOAT64)
+#undef TEMPLATE_TYPE
+#define TEMPLATE_TYPE float32_t
+#undef TEMPLATE_NAME
+#define TEMPLATE_NAME Float32
+
+void connx_TEMPLATE_NAME_exp(int32_t count, TEMPLATE_TYPE* y, TEMPLATE_TYPE* x) {
+    (TEMPLATE_NAME_math.exp)(count, y, x);
+}
+
+void connx_TEMPLATE_NAME_log(int32_t count, TEMPLATE_TYPE* y, TEMPLATE_TYPE* x) {
+    (TEMPLATE_NAME_math.log)(count, y, x);
+}
+
+void connx_TEMPLATE_NAME_tanh(int32_t count, TEMPLATE_TYPE* y, TEMPLATE_TYPE* x) {
+    (TEMPLATE_NAME_math.tanh)(count, y, x);
+}
+
+void connx_TEMPLATE_NAME_sigmoid(int32_t count, TEMPLATE_TYPE* y, TEMPLATE_TYPE* x) {
+    (TEMPLATE_NAME_math.sigmoid)(count, y, x);
+}
+
+void connx_TEMPLATE_NAME_asin(int32_t count, TEMPLATE_TYPE* y, TEMPLATE_TYPE* x) {
+    (TEMPLATE_NAME_math.asin)(count, y, x);
+}
+
+void connx_TEMPLATE_NAME_mish(int32_t count, TEMPLATE_TYPE* y, TEMPLATE_TYPE* x) {
+    (TEMPLATE_NAME_math.mish)(count, y, x);
+}
+TEMPLATE_END()
+
 // TODO: Implement basic function sfor STRING, BOOL, COMPLEX64, COMPLEX128
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h> // atoi
+#include <connx/accel.h>
+#include <connx/connx.h>
+#include <connx/hal.h>
+
+/**
+ * Microbenchmark of connx_Float32_gemm, prints GFLOP/s of the square matrices and the shapes of the Conv layers
+ *
+ * Usage: gemm [[repeat count]]
+ */
+typedef struct _Shape {
+    const char* name;
+    int32_t M, N, K;
+} Shape;
+
+static Shape shapes[] = {
+    {"square", 64, 64, 64},
+    {"square", 128, 128, 128},
+    {"square", 256, 256, 256},
+    {"square", 512, 512, 512},
+    {"square", 1024, 1024, 1024},
+    {"conv 3x3 64x64 tile", 64, 256, 576},
+    {"conv 3x3 512x512 tile", 512, 256, 4608},
+    {"conv 1x1 32x64 tile", 64, 256, 32},
+    {"winograd 256x256", 256, 32, 256},
+    {"fully connected", 1, 1000, 1024},
+    {"skinny", 8, 4096, 64},
+};
+
+int main(int argc, char** argv) {
+    int32_t repeat = argc > 1 ? atoi(argv[1]) : 5;
+
+    connx_init();
+
+    printf("%-24s %6s %6s %6s %10s %10s\n", "shape", "M", "N", "K", "ms", "GFLOP/s");
+
+    for(uint32_t i = 0; i < sizeof(shapes) / sizeof(Shape); i++) {
+        Shape* shape = &shapes[i];
+        float32_t* A = connx_alloc(sizeof(float32_t) * shape->M * shape->K);
+        float32_t* B = connx_alloc(sizeof(float32_t) * shape->K * shape->N);
+        float32_t* C = connx_alloc(sizeof(float32_t) * shape->M * shape->N);
+        if(A == NULL || B == NULL || C == NULL) {
+            connx_error("Out of memory\n");
+            return CONNX_NOT_ENOUGH_MEMORY;
+        }
+
+        for(int32_t j = 0; j < shape->M * shape->K; j++) {
+            A[j] = (float32_t)(j % 7) - 3;
+        }
+
+        for(int32_t j = 0; j < shape->K * shape->N; j++) {
+            B[j] = (float32_t)(j % 5) - 2;
+        }
+
+        // The first run warms up the caches
+        uint64_t best = UINT64_MAX;
+        for(int32_t j = 0; j <= repeat; j++) {
+            uint64_t start = connx_clock();
+            connx_Float32_gemm(shape->M, shape->N, shape->K, A, shape->K, B, shape->N, C, shape->N);
+            uint64_t time = connx_clock() - start;
+
+            if(j > 0 && time < best) {
+                best = time;
+            }
+        }
+
+        double flops = 2.0 * shape->M * shape->N * shape->K;
+        printf("%-24s %6d %6d %6d %10.3f %10.2f\n", shape->name, shape->M, shape->N, shape->K, best / 1000.0,
+               best > 0 ? flops / best / 1000 : 0);
+
+        connx_free(A);
+        connx_free(B);
+        connx_free(C);
+    }
+
+    connx_destroy();
+
+    return 0;
+}
@@ -1,10 +1,15 @@
-#define _POSIX_C_SOURCE 199309L
+#define _POSIX_C_SOURCE 200112L
 #include <inttypes.h>
 #include <malloc.h>
+#include <sched.h> // sched_yield
 #include <stdarg.h>
+#include <stdlib.h> // getenv
 #include <string.h>
+#include <fcntl.h> // open
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <time.h>
+#include <unistd.h> // sysconf
 
 #include <connx/accel.h>
 #include <connx/tensor.h>
@@ -18,9 +23,14 @@ static FILE* _tensorout;
 
 // Lifecycle
 void connx_init() {
+    connx_accel_init();
 }
 
+static void Pool_destroy();
+
 void connx_destroy() {
+    Pool_destroy();
+
     if(_tensorin != NULL) {
         fclose(_tensorin);
     }
@@ -116,6 +126,52 @@ void connx_unload(__attribute__((unused)) void* buf) {
     free(buf);
 }
 
+void* connx_map(const char* name, uint32_t* size) {
+    char path[256];
+    snprintf(path, 256, "%s/%s", _model_path, name);
+
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0 || st.st_size > UINT32_MAX) {
+        fprintf(stderr, "HAL ERROR: Cannot map file: '%s'\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    // Start reading the file in the background, the pages are faulted in from the page cache later
+    posix_fadvise(fd, 0, st.st_size, POSIX_FADV_WILLNEED);
+
+    void* buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file
+
+    if(buf == MAP_FAILED) {
+        fprintf(stderr, "HAL ERROR: Cannot map file: '%s'\n", path);
+        return NULL;
+    }
+
+    posix_madvise(buf, st.st_size, POSIX_MADV_WILLNEED);
+
+    *size = st.st_size;
+
+    return buf;
+}
+
+void connx_unmap(void* buf, uint32_t size) {
+    munmap(buf, size);
+}
+
+// Clock
+uint64_t connx_clock() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (uint64_t)time.tv_sec * 1000000 + time.tv_nsec / 1000;
+}
+
 // Tensor I/O
 int32_t connx_read(void* buf, int32_t size) {
     FILE* file = _tensorin != NULL ? _tensorin : stdin;
@@ -181,14 +237,220 @@ void connx_Lock_unlock(connx_Lock* lock) {
 }
 
 // Thread pool
+/**
+ * Workers are created once, on the first connx_Thread_alloc, and wait for tasks until connx_destroy.
+ * The number of threads is CONNX_THREADS environment variable or the number of online processors, including the
+ * caller thread which joins the work in connx_parallel_for.
+ */
+#define MAX_WORKER_COUNT 64
+
+typedef struct _Worker {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    connx_Task task; // NULL if the worker is idle
+    void* context;
+    bool is_reserved;   // guarded by _pool_lock
+    bool is_terminated; // guarded by lock
+} Worker;
+
+static Worker _workers[MAX_WORKER_COUNT];
+static uint32_t _worker_count;
+static pthread_mutex_t _pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t _pool_once = PTHREAD_ONCE_INIT;
+
+static void* Worker_main(void* arg) {
+    Worker* worker = arg;
+
+    pthread_mutex_lock(&worker->lock);
+
+    while(true) {
+        while(worker->task == NULL && !worker->is_terminated) {
+            pthread_cond_wait(&worker->cond, &worker->lock);
+        }
+
+        if(worker->task == NULL) {
+            break;
+        }
+
+        connx_Task task = worker->task;
+        void* context = worker->context;
+
+        pthread_mutex_unlock(&worker->lock);
+        task(context);
+        pthread_mutex_lock(&worker->lock);
+
+        worker->task = NULL;
+        pthread_cond_broadcast(&worker->cond);
+    }
+
+    pthread_mutex_unlock(&worker->lock);
+
+    return NULL;
+}
+
+static void Pool_init() {
+    char* env = getenv("CONNX_THREADS");
+    long thread_count = env != NULL ? strtol(env, NULL, 10) : sysconf(_SC_NPROCESSORS_ONLN);
+
+    uint32_t worker_count = thread_count > 1 ? thread_count - 1 : 0;
+    if(worker_count > MAX_WORKER_COUNT) {
+        worker_count = MAX_WORKER_COUNT;
+    }
+
+    for(uint32_t i = 0; i < worker_count; i++) {
+        Worker* worker = &_workers[i];
+
+        pthread_mutex_init(&worker->lock, NULL);
+        pthread_cond_init(&worker->cond, NULL);
+        worker->task = NULL;
+        worker->is_reserved = false;
+        worker->is_terminated = false;
+
+        if(pthread_create(&worker->thread, NULL, Worker_main, worker) != 0) {
+            connx_error("Cannot create worker thread, run with %u workers\n", i);
+
+            pthread_cond_destroy(&worker->cond);
+            pthread_mutex_destroy(&worker->lock);
+            break;
+        }
+
+        _worker_count = i + 1;
+    }
+}
+
+static void Pool_destroy() {
+    pthread_mutex_lock(&_pool_lock);
+    uint32_t worker_count = _worker_count;
+    _worker_count = 0; // No more workers are reserved
+    pthread_mutex_unlock(&_pool_lock);
+
+    for(uint32_t i = 0; i < worker_count; i++) {
+        Worker* worker = &_workers[i];
+
+        pthread_mutex_lock(&worker->lock);
+        worker->is_terminated = true;
+        pthread_cond_broadcast(&worker->cond);
+        pthread_mutex_unlock(&worker->lock);
+
+        pthread_join(worker->thread, NULL);
+
+        pthread_cond_destroy(&worker->cond);
+        pthread_mutex_destroy(&worker->lock);
+    }
+}
+
 uint32_t connx_Thread_alloc(uint32_t count, connx_Thread* threads) {
-    return 0;
+    pthread_once(&_pool_once, Pool_init);
+
+    uint32_t reserved = 0;
+
+    pthread_mutex_lock(&_pool_lock);
+    for(uint32_t i = 0; i < _worker_count && reserved < count; i++) {
+        if(!_workers[i].is_reserved) {
+            _workers[i].is_reserved = true;
+            threads[reserved++] = i;
+        }
+    }
+    pthread_mutex_unlock(&_pool_lock);
+
+    return reserved;
 }
 
 void connx_Thread_free(uint32_t count, connx_Thread* threads) {
+    pthread_mutex_lock(&_pool_lock);
+    for(uint32_t i = 0; i < count; i++) {
+        _workers[threads[i]].is_reserved = false;
+    }
+    pthread_mutex_unlock(&_pool_lock);
+}
+
+void connx_Thread_run(connx_Thread thread, connx_Task task, void* context) {
+    Worker* worker = &_workers[thread];
+
+    pthread_mutex_lock(&worker->lock);
+    worker->task = task;
+    worker->context = context;
+    pthread_cond_broadcast(&worker->cond);
+    pthread_mutex_unlock(&worker->lock);
 }
 
 void connx_Thread_join(uint32_t count, connx_Thread* threads) {
+    for(uint32_t i = 0; i < count; i++) {
+        Worker* worker = &_workers[threads[i]];
+
+        pthread_mutex_lock(&worker->lock);
+        while(worker->task != NULL) {
+            pthread_cond_wait(&worker->cond, &worker->lock);
+        }
+        pthread_mutex_unlock(&worker->lock);
+    }
+}
+
+void connx_Thread_yield() {
+    sched_yield();
+}
+
+// Parallel loop
+typedef struct _Loop {
+    int32_t range;
+    int32_t chunk;
+    int32_t next; // start of the next chunk, taken atomically
+    connx_ParallelTask task;
+    void* context;
+} Loop;
+
+static void Loop_run(void* context) {
+    Loop* loop = context;
+
+    while(true) {
+        int32_t start = __atomic_fetch_add(&loop->next, loop->chunk, __ATOMIC_RELAXED);
+        if(start >= loop->range) {
+            break;
+        }
+
+        int32_t end = loop->range - start > loop->chunk ? start + loop->chunk : loop->range;
+        loop->task(loop->context, start, end);
+    }
+}
+
+/**
+ * Split the range into chunks and run them by the caller and the idle workers. The loop runs on the caller thread
+ * only when there is no idle worker, e.g. a parallel_for nested in another one.
+ */
+void connx_parallel_for(int32_t range, int32_t grain, connx_ParallelTask task, void* context) {
+    if(range <= 0) {
+        return;
+    }
+
+    grain = grain > 0 ? grain : 1;
+
+    int32_t chunk_count = (range + grain - 1) / grain;
+    if(chunk_count <= 1) {
+        task(context, 0, range);
+        return;
+    }
+
+    connx_Thread threads[MAX_WORKER_COUNT];
+    uint32_t max_count = chunk_count - 1 < MAX_WORKER_COUNT ? chunk_count - 1 : MAX_WORKER_COUNT;
+    uint32_t count = connx_Thread_alloc(max_count, threads);
+    if(count == 0) {
+        task(context, 0, range);
+        return;
+    }
+
+    // A few chunks per thread balances the load without contending on the counter
+    int32_t chunk = range / ((int32_t)(count + 1) * 4);
+    Loop loop = {range, chunk > grain ? chunk : grain, 0, task, context};
+
+    for(uint32_t i = 0; i < count; i++) {
+        connx_Thread_run(threads[i], Loop_run, &loop);
+    }
+
+    Loop_run(&loop);
+
+    connx_Thread_join(count, threads);
+    connx_Thread_free(count, threads);
 }
 
 // error
@@ -1,4 +1,6 @@
+#include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h> // getenv
 #include <string.h>
 #include <connx/connx.h>
 
@@ -12,6 +14,8 @@ int main(int argc, char** argv) {
         return 0;
     }
 
+    connx_init();
+
     int32_t ret;
 
     ret = connx_set_model(argv[1]);
@@ -35,9 +39,24 @@ int main(int argc, char** argv) {
     connx_Model model;
     ret = connx_Model_init(&model);
     if(ret != 0) {
+        connx_Model_destroy(&model);
         return ret;
     }
 
+    // Print statistics of each run to stderr, stdout may be used for Tensor I/O
+    bool stats = getenv("CONNX_STATS") != NULL;
+
+    // Run the nodes one by one in the model order, for debugging
+    model.context->is_sequential = getenv("CONNX_SEQUENTIAL") != NULL;
+
+    if(stats) {
+        fprintf(stderr,
+                "STATS: load model %.3f ms, graph %.3f ms, initializer %.3f ms, wait %.3f ms, analysis %.3f ms, "
+                "total %.3f ms\n",
+                model.load_time.model / 1000.0, model.load_time.graph / 1000.0, model.load_time.initializer / 1000.0,
+                model.load_time.wait / 1000.0, model.load_time.analysis / 1000.0, model.load_time.total / 1000.0);
+    }
+
     // loop: input -> inference -> output
     // If input_count is -1 then exit the loop
     while(true) {
@@ -113,6 +132,7 @@ int main(int argc, char** argv) {
         // Run model
         uint32_t output_count = 16;
         connx_Tensor* outputs[output_count];
+        uint64_t copied_bytes = connx_Tensor_copied_bytes();
 
         ret = connx_Model_run(&model, input_count, inputs, &output_count, outputs);
         if(ret != CONNX_OK) {
@@ -184,6 +204,13 @@ int main(int argc, char** argv) {
         for(uint32_t i = 0; i < output_count; i++) {
             connx_Tensor_unref(outputs[i]);
         }
+
+        if(stats) {
+            connx_Plan* plan = &model.graphs[0]->plan;
+            fprintf(stderr, "STATS: peak %u bytes, arena %u bytes, without reuse %u bytes, copied %" PRIu64 " bytes\n",
+                    model.context->peak_bytes, plan->arena_size, plan->total_size,
+                    connx_Tensor_copied_bytes() - copied_bytes);
+        }
     }
 
     connx_Model_destroy(&model);
@@ -0,0 +1,185 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h> // atoi
+#include <string.h>
+#include <connx/connx.h>
+#include <connx/hal.h>
+
+int connx_set_model(const char* path);
+
+/**
+ * Test of the reentrant contexts, runs a model on several contexts of its graph at the same time and compares the
+ * outputs of each run with a sequential run of the default context. Inputs are test_data_set_0/input_*.data.
+ *
+ * Usage: threads [connx model path] [[thread count]]
+ */
+#define MAX_INPUT_COUNT 16
+#define MAX_OUTPUT_COUNT 16
+#define RUN_COUNT 8 // runs of each thread, the later ones use the memory plan made by the former ones
+
+typedef struct _Worker {
+    pthread_t thread;
+    connx_Graph* graph;
+    uint32_t input_count;
+    connx_Tensor** inputs;
+    uint32_t output_count;
+    connx_Tensor** expects;
+    int ret;
+} Worker;
+
+static bool is_equal(connx_Tensor* tensor, connx_Tensor* expect) {
+    return tensor->dtype == expect->dtype && tensor->ndim == expect->ndim &&
+           memcmp(tensor->shape, expect->shape, sizeof(int32_t) * expect->ndim) == 0 &&
+           memcmp(tensor->buffer, expect->buffer, expect->size) == 0;
+}
+
+// Run on copies of the inputs, connx_Context_run takes over the references of its inputs
+static int run(connx_Context* context, uint32_t input_count, connx_Tensor** inputs, uint32_t* output_count,
+               connx_Tensor** outputs) {
+    connx_Tensor* copies[input_count];
+    for(uint32_t i = 0; i < input_count; i++) {
+        copies[i] = connx_Tensor_copy(inputs[i]);
+        if(copies[i] == NULL) {
+            connx_error("Out of memory\n");
+            for(uint32_t j = 0; j < i; j++) {
+                connx_Tensor_unref(copies[j]);
+            }
+            return CONNX_NOT_ENOUGH_MEMORY;
+        }
+    }
+
+    return connx_Context_run(context, input_count, copies, output_count, outputs);
+}
+
+static void* work(void* _worker) {
+    Worker* worker = _worker;
+
+    connx_Context context;
+    worker->ret = connx_Context_init(&context, worker->graph);
+
+    for(uint32_t i = 0; i < RUN_COUNT && worker->ret == CONNX_OK; i++) {
+        uint32_t output_count = MAX_OUTPUT_COUNT;
+        connx_Tensor* outputs[MAX_OUTPUT_COUNT];
+
+        worker->ret = run(&context, worker->input_count, worker->inputs, &output_count, outputs);
+        if(worker->ret != CONNX_OK) {
+            break;
+        }
+
+        if(output_count != worker->output_count) {
+            connx_error("Run %u has %u outputs, the sequential run has %u\n", i, output_count, worker->output_count);
+            worker->ret = CONNX_TENSOR_SHAPE_NOT_MATCHING;
+        }
+
+        for(uint32_t j = 0; j < output_count; j++) {
+            if(worker->ret == CONNX_OK && !is_equal(outputs[j], worker->expects[j])) {
+                connx_error("Output %u of run %u is different from the sequential run\n", j, i);
+                worker->ret = CONNX_TENSOR_SHAPE_NOT_MATCHING;
+            }
+
+            connx_Tensor_unref(outputs[j]);
+        }
+    }
+
+    connx_Context_destroy(&context);
+
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        connx_info("Usage: threads [connx model path] [[thread count]]\n");
+        return 0;
+    }
+
+    uint32_t thread_count = argc > 2 ? atoi(argv[2]) : 4;
+
+    connx_init();
+
+    int ret = connx_set_model(argv[1]);
+    if(ret != 0) {
+        return ret;
+    }
+
+    connx_Model model;
+    ret = connx_Model_init(&model);
+    if(ret != CONNX_OK) {
+        connx_Model_destroy(&model);
+        return ret;
+    }
+
+    // Read inputs
+    uint32_t input_count = 0;
+    connx_Tensor* inputs[MAX_INPUT_COUNT];
+    for(; input_count < MAX_INPUT_COUNT; input_count++) {
+        char name[256];
+        snprintf(name, 256, "%s/test_data_set_0/input_%u.data", argv[1], input_count);
+
+        FILE* file = fopen(name, "r");
+        if(file == NULL) {
+            break;
+        }
+        fclose(file);
+
+        snprintf(name, 256, "test_data_set_0/input_%u.data", input_count);
+        void* buf = connx_load(name);
+        if(buf == NULL) {
+            ret = CONNX_RESOURCE_NOT_FOUND;
+            break;
+        }
+
+        inputs[input_count] = connx_Tensor_alloc_buffer(buf);
+        connx_unload(buf);
+
+        if(inputs[input_count] == NULL) {
+            connx_error("Out of memory\n");
+            ret = CONNX_NOT_ENOUGH_MEMORY;
+            break;
+        }
+    }
+
+    // The sequential run of the default context is the expected outputs
+    uint32_t output_count = MAX_OUTPUT_COUNT;
+    connx_Tensor* expects[MAX_OUTPUT_COUNT];
+    if(ret == CONNX_OK) {
+        model.context->is_sequential = true;
+        ret = run(model.context, input_count, inputs, &output_count, expects);
+    } else {
+        output_count = 0;
+    }
+
+    if(ret == CONNX_OK) {
+        Worker workers[thread_count];
+        for(uint32_t i = 0; i < thread_count; i++) {
+            workers[i] = (Worker){0, model.graphs[0], input_count, inputs, output_count, expects, CONNX_OK};
+            if(pthread_create(&workers[i].thread, NULL, work, &workers[i]) != 0) {
+                connx_error("Cannot create thread %u\n", i);
+                thread_count = i;
+                ret = CONNX_NOT_ENOUGH_MEMORY;
+                break;
+            }
+        }
+
+        for(uint32_t i = 0; i < thread_count; i++) {
+            pthread_join(workers[i].thread, NULL);
+            if(ret == CONNX_OK) {
+                ret = workers[i].ret;
+            }
+        }
+
+        for(uint32_t i = 0; i < output_count; i++) {
+            connx_Tensor_unref(expects[i]);
+        }
+    }
+
+    for(uint32_t i = 0; i < input_count; i++) {
+        connx_Tensor_unref(inputs[i]);
+    }
+
+    connx_Model_destroy(&model);
+    connx_destroy();
+
+    printf("%s: %u threads x %u runs %s\n", argv[1], thread_count, RUN_COUNT, ret == CONNX_OK ? "passed" : "failed");
+
+    return ret;
+}
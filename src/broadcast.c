@@ -0,0 +1,238 @@
+#include <connx/accel.h>
+#include <connx/connx.h>
+#include <connx/hal.h>
+
+/**
+ * Binary elementwise operators with the multidirectional broadcast
+ *
+ * The dimensions are aligned to the last one and the strides of A and B in C are computed once, 0 for a broadcast
+ * dimension. Adjacent dimensions in which each input is broadcast in both or in neither are collapsed into one, so a
+ * scalar is one dimension and a row ([N] to [M, N]) or a column ([M, 1] to [M, N]) is two. The last dimension is the
+ * inner loop, the SIMD kernel of accel if both inputs are contiguous in it or a loop with a scalar operand if one of
+ * them is broadcast. The outer dimensions are walked by a counter without a division per element.
+ */
+#define BROADCAST_GRAIN 4096 // elements of C in a task at least
+
+typedef struct _BroadcastTask {
+    connx_ElementwiseOp op;
+    int32_t ndim; // collapsed
+    int32_t* shape;
+    int32_t* A_strides;
+    int32_t* B_strides;
+    void* A;
+    void* B;
+    void* C;
+} BroadcastTask;
+
+TEMPLATE_START(UINT8, UINT16, UINT32, UINT64, INT8, INT16, INT32, INT64, FLOAT32, FLOAT64)
+#undef TEMPLATE_TYPE
+#define TEMPLATE_TYPE int32_t
+// A row of C, a_step and b_step are 1 for a contiguous input and 0 for a broadcast one
+static void _row_TEMPLATE_NAME(connx_ElementwiseOp op, int32_t count, TEMPLATE_TYPE* c, TEMPLATE_TYPE* a,
+                               int32_t a_step, TEMPLATE_TYPE* b, int32_t b_step) {
+    if(a_step != 0 && b_step != 0) {
+        switch(op) {
+            case CONNX_ELEMENTWISE_ADD:
+                connx_TEMPLATE_NAME_add(count, c, a, b);
+                break;
+            case CONNX_ELEMENTWISE_SUB:
+                connx_TEMPLATE_NAME_sub(count, c, a, b);
+                break;
+            case CONNX_ELEMENTWISE_MUL:
+                connx_TEMPLATE_NAME_mul(count, c, a, b);
+                break;
+            default:
+                break;
+        }
+    } else if(a_step == 0) {
+        TEMPLATE_TYPE x = *a;
+
+        switch(op) {
+            case CONNX_ELEMENTWISE_ADD:
+                for(int32_t i = 0; i < count; i++) {
+                    c[i] = x + b[i];
+                }
+                break;
+            case CONNX_ELEMENTWISE_SUB:
+                for(int32_t i = 0; i < count; i++) {
+                    c[i] = x - b[i];
+                }
+                break;
+            case CONNX_ELEMENTWISE_MUL:
+                for(int32_t i = 0; i < count; i++) {
+                    c[i] = x * b[i];
+                }
+                break;
+            default:
+                break;
+        }
+    } else {
+        TEMPLATE_TYPE y = *b;
+
+        switch(op) {
+            case CONNX_ELEMENTWISE_ADD:
+                for(int32_t i = 0; i < count; i++) {
+                    c[i] = a[i] + y;
+                }
+                break;
+            case CONNX_ELEMENTWISE_SUB:
+                for(int32_t i = 0; i < count; i++) {
+                    c[i] = a[i] - y;
+                }
+                break;
+            case CONNX_ELEMENTWISE_MUL:
+                for(int32_t i = 0; i < count; i++) {
+                    c[i] = a[i] * y;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Rows [start, end) of C, a row is the last dimension
+static void _run_TEMPLATE_NAME(void* context, int32_t start, int32_t end) {
+    BroadcastTask* task = context;
+    int32_t outer = task->ndim - 1;
+    int32_t* shape = task->shape;
+    int32_t* A_strides = task->A_strides;
+    int32_t* B_strides = task->B_strides;
+    int32_t count = shape[outer];
+
+    int32_t index[outer + 1];
+    int32_t A_offset = 0;
+    int32_t B_offset = 0;
+    for(int32_t i = outer - 1, rest = start; i >= 0; i--) {
+        index[i] = rest % shape[i];
+        rest /= shape[i];
+        A_offset += index[i] * A_strides[i];
+        B_offset += index[i] * B_strides[i];
+    }
+
+    TEMPLATE_TYPE* A = task->A;
+    TEMPLATE_TYPE* B = task->B;
+    TEMPLATE_TYPE* C = task->C;
+
+    for(int32_t row = start; row < end; row++) {
+        _row_TEMPLATE_NAME(task->op, count, C + row * count, A + A_offset, A_strides[outer], B + B_offset,
+                           B_strides[outer]);
+
+        for(int32_t i = outer - 1; i >= 0; i--) {
+            A_offset += A_strides[i];
+            B_offset += B_strides[i];
+            if(++index[i] < shape[i]) {
+                break;
+            }
+
+            A_offset -= A_strides[i] * shape[i];
+            B_offset -= B_strides[i] * shape[i];
+            index[i] = 0;
+        }
+    }
+}
+TEMPLATE_END()
+
+int connx_run_binary(connx_Context* context, const char* op_type, connx_ElementwiseOp op, uint32_t* outputs,
+                     uint32_t* inputs) {
+    connx_Tensor* A = connx_Context_get(context, inputs[0]);
+    connx_Tensor* B = connx_Context_get(context, inputs[1]);
+
+    if(A->dtype != B->dtype) {
+        connx_error("%s: Datatypes of the inputs are not the same.\n", op_type);
+        return CONNX_DATA_TYPE_NOT_MATCHING;
+    }
+
+    int32_t ndim = A->ndim > B->ndim ? A->ndim : B->ndim;
+    int32_t shape[ndim + 1];
+    int32_t A_dims[ndim + 1];
+    int32_t B_dims[ndim + 1];
+    for(int32_t i = 0; i < ndim; i++) {
+        A_dims[i] = i < ndim - A->ndim ? 1 : A->shape[i - (ndim - A->ndim)];
+        B_dims[i] = i < ndim - B->ndim ? 1 : B->shape[i - (ndim - B->ndim)];
+
+        if(A_dims[i] == B_dims[i] || B_dims[i] == 1) {
+            shape[i] = A_dims[i];
+        } else if(A_dims[i] == 1) {
+            shape[i] = B_dims[i];
+        } else {
+            connx_error("%s: Shapes of the inputs cannot be broadcast.\n", op_type);
+            return CONNX_TENSOR_SHAPE_NOT_MATCHING;
+        }
+    }
+
+    connx_Tensor* C = connx_Context_alloc_inplace(context, outputs[0], A->dtype, ndim, shape);
+    if(C == NULL) {
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+
+    // The dimensions of 1 are dropped and the neighbours of the same broadcast are merged
+    int32_t collapsed_ndim = 0;
+    int32_t collapsed_shape[ndim + 1];
+    bool A_is_broadcasts[ndim + 1];
+    bool B_is_broadcasts[ndim + 1];
+    for(int32_t i = 0; i < ndim; i++) {
+        if(shape[i] == 1) {
+            continue;
+        }
+
+        bool A_is_broadcast = A_dims[i] == 1;
+        bool B_is_broadcast = B_dims[i] == 1;
+        int32_t last = collapsed_ndim - 1;
+
+        if(last >= 0 && A_is_broadcasts[last] == A_is_broadcast && B_is_broadcasts[last] == B_is_broadcast) {
+            collapsed_shape[last] *= shape[i];
+        } else {
+            collapsed_shape[collapsed_ndim] = shape[i];
+            A_is_broadcasts[collapsed_ndim] = A_is_broadcast;
+            B_is_broadcasts[collapsed_ndim] = B_is_broadcast;
+            collapsed_ndim++;
+        }
+    }
+
+    // All the inputs are scalars
+    if(collapsed_ndim == 0) {
+        collapsed_shape[0] = 1;
+        A_is_broadcasts[0] = B_is_broadcasts[0] = false;
+        collapsed_ndim = 1;
+    }
+
+    int32_t A_strides[collapsed_ndim];
+    int32_t B_strides[collapsed_ndim];
+    for(int32_t i = collapsed_ndim - 1, A_unit = 1, B_unit = 1; i >= 0; i--) {
+        A_strides[i] = A_is_broadcasts[i] ? 0 : A_unit;
+        B_strides[i] = B_is_broadcasts[i] ? 0 : B_unit;
+        A_unit *= A_is_broadcasts[i] ? 1 : collapsed_shape[i];
+        B_unit *= B_is_broadcasts[i] ? 1 : collapsed_shape[i];
+    }
+
+    int32_t count = collapsed_shape[collapsed_ndim - 1];
+    int32_t rows = connx_Int32_product(collapsed_ndim - 1, collapsed_shape);
+
+    // An empty tensor
+    if(count == 0 || rows == 0) {
+        connx_Context_set(context, outputs[0], C);
+        return CONNX_OK;
+    }
+
+    int32_t grain = count < BROADCAST_GRAIN ? BROADCAST_GRAIN / count : 1;
+    BroadcastTask task = {op, collapsed_ndim, collapsed_shape, A_strides, B_strides, A->buffer, B->buffer, C->buffer};
+
+    switch(A->dtype) {
+        TEMPLATE_START(UINT8, UINT16, UINT32, UINT64, INT8, INT16, INT32, INT64, FLOAT32, FLOAT64)
+#undef TEMPLATE_DTYPE
+#define TEMPLATE_DTYPE INT32
+        case TEMPLATE_DTYPE:
+            connx_parallel_for(rows, grain, _run_TEMPLATE_NAME, &task);
+            break;
+            TEMPLATE_END()
+        default:
+            connx_error("%s: Datatype %d is not supported yet.\n", op_type, A->dtype);
+            connx_Tensor_unref(C); // the reference which is taken on the input when it is written in place
+            return CONNX_NOT_SUPPORTED_DATATYPE;
+    }
+
+    connx_Context_set(context, outputs[0], C);
+
+    return CONNX_OK;
+}
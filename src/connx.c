@@ -67,6 +67,49 @@ static char* _strdup(char* str) {
         str;                                \
     })
 
+// Index of op_type in the opset, or -1 if not supported
+static int32_t find_operator(char* op_type) {
+    for(int32_t i = 0; connx_opset_names[i] != NULL; i++) {
+        if(strcmp(op_type, connx_opset_names[i]) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+int connx_AutoPad_parse(char* auto_pad, connx_AutoPad* mode) {
+    if(strcmp(auto_pad, "NOTSET") == 0) {
+        *mode = CONNX_AUTO_PAD_NOTSET;
+    } else if(strcmp(auto_pad, "SAME_UPPER") == 0) {
+        *mode = CONNX_AUTO_PAD_SAME_UPPER;
+    } else if(strcmp(auto_pad, "SAME_LOWER") == 0) {
+        *mode = CONNX_AUTO_PAD_SAME_LOWER;
+    } else if(strcmp(auto_pad, "VALID") == 0) {
+        *mode = CONNX_AUTO_PAD_VALID;
+    } else {
+        connx_error("Illegal auto_pad: %s\n", auto_pad);
+        return CONNX_NOT_SUPPORTED_ATTRIBUTE;
+    }
+
+    return CONNX_OK;
+}
+
+int connx_AttributeInts_get(connx_AttributeInts* ints, uint32_t count, int32_t* array, int32_t value) {
+    if(ints->count == 0) {
+        for(uint32_t i = 0; i < count; i++) {
+            array[i] = value;
+        }
+    } else if(ints->count == count) {
+        memcpy(array, ints->array, sizeof(int32_t) * count);
+    } else {
+        connx_error("Illegal count of ints attribute: %u, %u is expected\n", ints->count, count);
+        return CONNX_NOT_SUPPORTED_ATTRIBUTE;
+    }
+
+    return CONNX_OK;
+}
+
 static int parse_Model(connx_Model* model, char* metadata) {
     char* token = metadata;
 
@@ -113,11 +156,410 @@ static int parse_Model(connx_Model* model, char* metadata) {
     return CONNX_OK;
 }
 
+/**
+ * Binary model (model.bin) is a single file which is mapped at once, bin/pack.py converts a text model to it.
+ * Numbers are 32-bit little endian and offsets are from the beginning of the file.
+ *
+ * header:      "CONNXBIN", format version, connx version, opset count, opset offset, graph count, graph offset
+ * opset:       name offset, version
+ * graph:       value_info count, initializer count/offset, output count/offset, input count/offset, node count/offset
+ * initializer: dtype, ndim, shape offset, data offset (aligned by 64 bytes)
+ * node:        op_type offset, output count, input count, attribute count, output/input/attribute offset
+ * attribute:   type, size, data offset
+ *
+ * Attribute data is in the memory layout of the attribute (float32_t, int32_t, string, connx_AttributeFloats and
+ * connx_AttributeInts), but STRINGS is the count followed by the strings. Strings are NUL terminated.
+ * Initializers point into the mapping, the other tables are copied.
+ */
+#define CONNX_BINARY_MAGIC "CONNXBIN"
+#define CONNX_BINARY_VERSION 1
+
+typedef struct _BinaryHeader {
+    char magic[8];
+    uint32_t format_version;
+    int32_t version;
+    uint32_t opset_count;
+    uint32_t opset_offset;
+    uint32_t graph_count;
+    uint32_t graph_offset;
+} BinaryHeader;
+
+typedef struct _BinaryOpset {
+    uint32_t name_offset;
+    uint32_t version;
+} BinaryOpset;
+
+typedef struct _BinaryGraph {
+    uint32_t value_info_count;
+    uint32_t initializer_count;
+    uint32_t initializer_offset;
+    uint32_t output_count;
+    uint32_t output_offset;
+    uint32_t input_count;
+    uint32_t input_offset;
+    uint32_t node_count;
+    uint32_t node_offset;
+} BinaryGraph;
+
+typedef struct _BinaryInitializer {
+    uint32_t dtype;
+    uint32_t ndim;
+    uint32_t shape_offset;
+    uint32_t data_offset;
+} BinaryInitializer;
+
+typedef struct _BinaryNode {
+    uint32_t op_type_offset;
+    uint32_t output_count;
+    uint32_t input_count;
+    uint32_t attribute_count;
+    uint32_t output_offset;
+    uint32_t input_offset;
+    uint32_t attribute_offset;
+} BinaryNode;
+
+typedef struct _BinaryAttribute {
+    uint32_t type;
+    uint32_t size;
+    uint32_t data_offset;
+} BinaryAttribute;
+
+// count items of size at offset, NULL if they are out of the file
+static void* binary_at(connx_Model* model, uint32_t offset, uint32_t count, uint32_t size) {
+    if((uint64_t)offset + (uint64_t)count * size > model->binary_size) {
+        connx_error("Illegal binary model: offset %u is out of the file\n", offset);
+        return NULL;
+    }
+
+    return (uint8_t*)model->binary + offset;
+}
+
+static char* binary_string(connx_Model* model, uint32_t offset) {
+    char* str = binary_at(model, offset, 0, 1);
+    if(str != NULL && memchr(str, '\0', model->binary_size - offset) == NULL) {
+        connx_error("Illegal binary model: string at %u is not terminated\n", offset);
+        return NULL;
+    }
+
+    return str;
+}
+
+static int parse_binary_Model(connx_Model* model) {
+    BinaryHeader* header = binary_at(model, 0, 1, sizeof(BinaryHeader));
+    if(header == NULL || memcmp(header->magic, CONNX_BINARY_MAGIC, 8) != 0) {
+        connx_error("Illegal binary model\n");
+        return CONNX_ILLEGAL_SYNTAX;
+    }
+
+    if(header->format_version != CONNX_BINARY_VERSION) {
+        connx_error("Not supported binary model version: %u\n", header->format_version);
+        return CONNX_NOT_SUPPORTED_CONNX_VERSION;
+    }
+
+    model->version = header->version;
+
+    if(model->version <= 0 || model->version > 1) {
+        connx_error("Not supported CONNX version: %u\n", model->version);
+        return CONNX_NOT_SUPPORTED_CONNX_VERSION;
+    }
+
+    BinaryOpset* opsets = binary_at(model, header->opset_offset, header->opset_count, sizeof(BinaryOpset));
+    if(opsets == NULL) {
+        return CONNX_ILLEGAL_SYNTAX;
+    }
+
+    model->opset_count = header->opset_count;
+
+    model->opset_names = connx_alloc(sizeof(char*) * model->opset_count);
+    model->opset_versions = connx_alloc(sizeof(uint32_t) * model->opset_count);
+    if(model->opset_names == NULL || model->opset_versions == NULL) {
+        connx_error("Out of memory\n");
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+
+    for(uint32_t i = 0; i < model->opset_count; i++) {
+        char* name = binary_string(model, opsets[i].name_offset);
+        if(name == NULL) {
+            return CONNX_ILLEGAL_SYNTAX;
+        }
+
+        model->opset_names[i] = _strdup(name);
+        if(model->opset_names[i] == NULL) {
+            connx_error("Out of memory\n");
+            return CONNX_NOT_ENOUGH_MEMORY;
+        }
+        model->opset_versions[i] = opsets[i].version;
+    }
+
+    if(binary_at(model, header->graph_offset, header->graph_count, sizeof(BinaryGraph)) == NULL) {
+        return CONNX_ILLEGAL_SYNTAX;
+    }
+
+    model->graph_count = header->graph_count;
+
+    return CONNX_OK;
+}
+
+// Whether the payload of an attribute of FLOAT, INT, STRING, FLOATS or INTS holds the value which its type needs
+static bool is_valid_attribute(BinaryAttribute* binary, void* data) {
+    uint32_t count = 0;
+
+    switch(binary->type) {
+        case 1: // FLOAT
+        case 2: // INT
+            return binary->size >= sizeof(uint32_t);
+        case 3: // STRING
+            return memchr(data, '\0', binary->size) != NULL;
+        case 6: // FLOATS
+        case 7: // INTS
+            if(binary->size < sizeof(uint32_t)) {
+                return false;
+            }
+
+            memcpy(&count, data, sizeof(uint32_t));
+            return count <= (binary->size - sizeof(uint32_t)) / sizeof(uint32_t);
+        default:
+            return false;
+    }
+}
+
+static int parse_binary_attribute(connx_Model* model, void** attribute, BinaryAttribute* binary) {
+    void* data = binary_at(model, binary->data_offset, binary->size, 1);
+    if(data == NULL) {
+        return CONNX_ILLEGAL_SYNTAX;
+    }
+
+    switch(binary->type) {
+        case 1: // FLOAT
+        case 2: // INT
+        case 3: // STRING
+        case 6: // FLOATS
+        case 7: // INTS
+            if(!is_valid_attribute(binary, data)) {
+                connx_error("Illegal binary model: attribute of type %u at %u doesn't fit in its size\n", binary->type,
+                            binary->data_offset);
+                return CONNX_ILLEGAL_SYNTAX;
+            }
+
+            *attribute = connx_alloc(binary->size);
+            if(*attribute == NULL) {
+                connx_error("Out of memory\n");
+                return CONNX_NOT_ENOUGH_MEMORY;
+            }
+
+            memcpy(*attribute, data, binary->size);
+            return CONNX_OK;
+        case 8: { // STRINGS: count and the NUL terminated strings
+            if(binary->size < sizeof(uint32_t)) {
+                connx_error("Illegal binary model: strings attribute at %u is too short\n", binary->data_offset);
+                return CONNX_ILLEGAL_SYNTAX;
+            }
+
+            uint32_t count;
+            memcpy(&count, data, sizeof(uint32_t));
+            char* strings = (char*)data + sizeof(uint32_t);
+            uint32_t size = binary->size - sizeof(uint32_t);
+
+            // Each string takes its terminator at least, and all of them end in the attribute
+            if(count > size) {
+                connx_error("Illegal binary model: %u strings in %u bytes at %u\n", count, size, binary->data_offset);
+                return CONNX_ILLEGAL_SYNTAX;
+            }
+
+            for(uint32_t j = 0, offset = 0; j < count; j++) {
+                char* end = memchr(strings + offset, '\0', size - offset);
+                if(end == NULL) {
+                    connx_error("Illegal binary model: string %u at %u is not terminated\n", j, binary->data_offset);
+                    return CONNX_ILLEGAL_SYNTAX;
+                }
+
+                offset = end - strings + 1;
+            }
+
+            connx_AttributeStrings* attr = connx_alloc(sizeof(connx_AttributeStrings) + sizeof(char*) * count + size);
+            if(attr == NULL) {
+                connx_error("Out of memory\n");
+                return CONNX_NOT_ENOUGH_MEMORY;
+            }
+
+            *attribute = attr;
+            attr->count = count;
+
+            char* buf = (char*)&attr->array[count]; // Point the next to the array
+            memcpy(buf, strings, size);
+
+            for(uint32_t j = 0; j < count; j++) {
+                attr->array[j] = buf;
+                buf += strlen(buf) + 1;
+            }
+            return CONNX_OK;
+        }
+        default:
+            connx_error("Attribute type %u is not supported.\n", binary->type);
+            return CONNX_NOT_SUPPORTED_ATTRIBUTE;
+    }
+}
+
+static int parse_binary_Graph(connx_Graph* graph) {
+    connx_Model* model = graph->model;
+    BinaryHeader* header = model->binary;
+    BinaryGraph* binary = (BinaryGraph*)((uint8_t*)model->binary + header->graph_offset) + graph->id;
+
+    graph->value_info_count = binary->value_info_count;
+
+    // initializer, the tensors point into the mapping
+    BinaryInitializer* initializers =
+        binary_at(model, binary->initializer_offset, binary->initializer_count, sizeof(BinaryInitializer));
+    if(initializers == NULL) {
+        return CONNX_ILLEGAL_SYNTAX;
+    }
+
+    graph->initializer_count = binary->initializer_count;
+    graph->initializers = connx_alloc(sizeof(connx_Tensor*) * graph->initializer_count);
+    if(graph->initializers == NULL) {
+        connx_error("Out of memory\n");
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+
+    for(uint32_t i = 0; i < graph->initializer_count; i++) {
+        BinaryInitializer* initializer = &initializers[i];
+
+        int32_t* shape = binary_at(model, initializer->shape_offset, initializer->ndim, sizeof(int32_t));
+        if(shape == NULL) {
+            return CONNX_ILLEGAL_SYNTAX;
+        }
+
+        uint32_t size = connx_DataType_size(initializer->dtype);
+        void* data = binary_at(model, initializer->data_offset, connx_Int32_product(initializer->ndim, shape), size);
+        if(data == NULL) {
+            return CONNX_ILLEGAL_SYNTAX;
+        }
+
+        graph->initializers[i] = connx_Tensor_wrap(initializer->dtype, initializer->ndim, shape, data);
+        if(graph->initializers[i] == NULL) {
+            connx_error("Out of memory\n");
+            return CONNX_NOT_ENOUGH_MEMORY;
+        }
+    }
+
+    // output, input
+    uint32_t* outputs = binary_at(model, binary->output_offset, binary->output_count, sizeof(uint32_t));
+    uint32_t* inputs = binary_at(model, binary->input_offset, binary->input_count, sizeof(uint32_t));
+    if(outputs == NULL || inputs == NULL) {
+        return CONNX_ILLEGAL_SYNTAX;
+    }
+
+    graph->output_count = binary->output_count;
+    graph->outputs = connx_alloc(sizeof(uint32_t) * graph->output_count);
+    graph->input_count = binary->input_count;
+    graph->inputs = connx_alloc(sizeof(uint32_t) * graph->input_count);
+    if(graph->outputs == NULL || graph->inputs == NULL) {
+        connx_error("Out of memory\n");
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+
+    memcpy(graph->outputs, outputs, sizeof(uint32_t) * graph->output_count);
+    memcpy(graph->inputs, inputs, sizeof(uint32_t) * graph->input_count);
+
+    // node
+    BinaryNode* nodes = binary_at(model, binary->node_offset, binary->node_count, sizeof(BinaryNode));
+    if(nodes == NULL) {
+        return CONNX_ILLEGAL_SYNTAX;
+    }
+
+    graph->node_count = binary->node_count;
+    graph->nodes = connx_alloc(sizeof(connx_Node*) * graph->node_count);
+    if(graph->nodes == NULL) {
+        connx_error("Out of memory\n");
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+
+    for(uint32_t i = 0; i < graph->node_count; i++) {
+        BinaryNode* binary_node = &nodes[i];
+
+        connx_Node* node = graph->nodes[i] = connx_alloc(sizeof(connx_Node));
+        if(node == NULL) {
+            connx_error("Out of memory\n");
+            return CONNX_NOT_ENOUGH_MEMORY;
+        }
+
+        char* op_type = binary_string(model, binary_node->op_type_offset);
+        if(op_type == NULL) {
+            return CONNX_ILLEGAL_SYNTAX;
+        }
+
+        node->op_type = _strdup(op_type);
+        if(node->op_type == NULL) {
+            connx_error("Out of memory\n");
+            return CONNX_NOT_ENOUGH_MEMORY;
+        }
+
+        int32_t op = find_operator(node->op_type);
+        if(op < 0) {
+            connx_error("Operator %s is not supported yet.\n", node->op_type);
+            return CONNX_NOT_SUPPORTED_OPERATOR;
+        }
+        node->op = connx_opset_ops[op];
+        node->infer = connx_opset_infers[op];
+        node->can_fuse = connx_opset_can_fuses[op];
+        node->fuse = connx_opset_fuses[op];
+
+        uint32_t* outputs = binary_at(model, binary_node->output_offset, binary_node->output_count, sizeof(uint32_t));
+        uint32_t* inputs = binary_at(model, binary_node->input_offset, binary_node->input_count, sizeof(uint32_t));
+        BinaryAttribute* attributes = binary_at(model, binary_node->attribute_offset, binary_node->attribute_count,
+                                                sizeof(BinaryAttribute));
+        if(outputs == NULL || inputs == NULL || attributes == NULL) {
+            return CONNX_ILLEGAL_SYNTAX;
+        }
+
+        node->output_count = binary_node->output_count;
+        node->input_count = binary_node->input_count;
+        node->attribute_count = binary_node->attribute_count;
+
+        node->outputs = connx_alloc(sizeof(uint32_t) * node->output_count);
+        node->inputs = connx_alloc(sizeof(uint32_t) * node->input_count);
+        node->attributes = connx_alloc(sizeof(uintptr_t) * node->attribute_count);
+        if(node->outputs == NULL || node->inputs == NULL || node->attributes == NULL) {
+            connx_error("Out of memory\n");
+            return CONNX_NOT_ENOUGH_MEMORY;
+        }
+
+        memcpy(node->outputs, outputs, sizeof(uint32_t) * node->output_count);
+        memcpy(node->inputs, inputs, sizeof(uint32_t) * node->input_count);
+
+        for(uint32_t j = 0; j < node->attribute_count; j++) {
+            int ret = parse_binary_attribute(model, &node->attributes[j], &attributes[j]);
+            if(ret != CONNX_OK) {
+                return ret;
+            }
+        }
+    }
+
+    return CONNX_OK;
+}
+
 int connx_Model_init(connx_Model* model) {
-    // Parse model
-    void* metadata = connx_load("model.connx");
-    int ret = parse_Model(model, metadata);
-    connx_unload(metadata);
+    int ret;
+    uint64_t start = connx_clock();
+
+    // connx_Model_destroy releases what is loaded when it fails
+    memset(model, 0, sizeof(connx_Model));
+
+    // Parse model, the binary model is preferred to the text model
+    model->binary = connx_map("model.bin", &model->binary_size);
+    if(model->binary != NULL) {
+        ret = parse_binary_Model(model);
+    } else {
+        void* metadata = connx_load("model.connx");
+        if(metadata == NULL) {
+            return CONNX_RESOURCE_NOT_FOUND;
+        }
+
+        ret = parse_Model(model, metadata);
+        connx_unload(metadata);
+    }
+
+    model->load_time.model = connx_clock() - start;
 
     if(ret != CONNX_OK) {
         return ret;
@@ -144,10 +586,26 @@ int connx_Model_init(connx_Model* model) {
         }
     }
 
-    return CONNX_OK;
+    // Default context for connx_Model_run
+    model->context = connx_alloc(sizeof(connx_Context));
+    if(model->context == NULL) {
+        connx_error("Out of memory\n");
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+
+    ret = connx_Context_init(model->context, model->graphs[0]);
+
+    model->load_time.total = connx_clock() - start;
+
+    return ret;
 }
 
 int connx_Model_destroy(connx_Model* model) {
+    if(model->context != NULL) {
+        connx_Context_destroy(model->context);
+        connx_free(model->context);
+    }
+
     if(model->graphs != NULL) {
         for(uint32_t i = 0; i < model->graph_count; i++) {
             if(model->graphs[i] != NULL) {
@@ -172,66 +630,154 @@ int connx_Model_destroy(connx_Model* model) {
         connx_free(model->opset_names);
     }
 
+    // Initializers point into the binary model
+    if(model->binary != NULL) {
+        connx_unmap(model->binary, model->binary_size);
+    }
+
     return CONNX_OK;
 }
 
 int connx_Model_run(connx_Model* model, uint32_t input_count, connx_Tensor** inputs, uint32_t* output_count,
                     connx_Tensor** outputs) {
-    return connx_Graph_run(model->graphs[0], input_count, inputs, output_count, outputs);
+    return connx_Context_run(model->context, input_count, inputs, output_count, outputs);
 }
 
-static int parse_initializer(connx_Tensor** tensor, uint32_t graph_id, uint32_t initializer_id) {
+/**
+ * Initializer file: [dtype] [ndim] [shape] [data]
+ * The file is mapped and the tensor points into the mapping, so the weights are not copied. The data is copied
+ * only when it is not aligned for its data type.
+ */
+static int parse_initializer(connx_Graph* graph, uint32_t initializer_id) {
     char name[16];
-    snprintf(name, 16, "%u_%u.data", graph_id, initializer_id);
+    snprintf(name, 16, "%u_%u.data", graph->id, initializer_id);
 
-    void* buf = connx_load(name);
+    uint32_t size;
+    void* buf = connx_map(name, &size);
     if(buf == NULL) {
+        connx_error("Initializer not found: '%s'\n", name);
         return CONNX_RESOURCE_NOT_FOUND;
     }
 
-    *tensor = connx_Tensor_alloc_buffer(buf);
-    if(*tensor == NULL) {
+    uint32_t dtype = size >= sizeof(uint32_t) * 2 ? ((uint32_t*)buf)[0] : 0;
+    uint32_t ndim = size >= sizeof(uint32_t) * 2 ? ((uint32_t*)buf)[1] : UINT32_MAX;
+    int32_t* shape = (int32_t*)buf + 2;
+
+    uint64_t header_size = sizeof(uint32_t) * (2 + (uint64_t)ndim);
+    uint32_t dsize = connx_DataType_size(dtype);
+
+    if(size < header_size || size - header_size < (uint64_t)dsize * connx_Int32_product(ndim, shape)) {
+        connx_error("Illegal initializer: '%s'\n", name);
+        connx_unmap(buf, size);
+        return CONNX_ILLEGAL_SYNTAX;
+    }
+
+    void* data = shape + ndim;
+
+    connx_Tensor* tensor;
+    uint32_t index = initializer_id - 1;
+
+    if(dsize == 0 || (uintptr_t)data % dsize == 0) {
+        tensor = connx_Tensor_wrap(dtype, ndim, shape, data);
+        graph->mappings[index] = buf;
+        graph->mapping_sizes[index] = size;
+    } else {
+        tensor = connx_Tensor_alloc_buffer(buf);
+        connx_unmap(buf, size);
+    }
+
+    if(tensor == NULL) {
+        connx_error("Out of memory\n");
         return CONNX_NOT_ENOUGH_MEMORY;
     }
 
-    connx_unload(buf);
+    graph->initializers[index] = tensor;
 
     return CONNX_OK;
 }
 
-static int parse_Graph(connx_Graph* graph, char* text) {
+/**
+ * Initializers are loaded by the idle workers of the thread pool while the caller parses the rest of the graph,
+ * then the caller loads what is left and waits for the workers.
+ */
+#define LOADER_THREAD_COUNT 16
+
+typedef struct _Loader {
+    connx_Graph* graph;
+    uint32_t next; // next initializer to load, taken atomically
+    int ret;       // error of the first failed initializer
+    uint64_t start;
+    uint64_t end; // when the last initializer is loaded
+
+    uint32_t thread_count;
+    connx_Thread threads[LOADER_THREAD_COUNT];
+} Loader;
+
+static void Loader_run(void* context) {
+    Loader* loader = context;
+    connx_Graph* graph = loader->graph;
+
+    while(true) {
+        uint32_t i = __atomic_fetch_add(&loader->next, 1, __ATOMIC_RELAXED);
+        if(i >= graph->initializer_count) {
+            break;
+        }
+
+        int ret = parse_initializer(graph, i + 1);
+        if(ret != CONNX_OK) {
+            int expected = CONNX_OK;
+            __atomic_compare_exchange_n(&loader->ret, &expected, ret, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+            __atomic_store_n(&loader->next, graph->initializer_count, __ATOMIC_RELAXED); // Stop loading
+        }
+    }
+
+    uint64_t end = connx_clock();
+    uint64_t last = __atomic_load_n(&loader->end, __ATOMIC_RELAXED);
+    while(end > last &&
+          !__atomic_compare_exchange_n(&loader->end, &last, end, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+static void Loader_start(Loader* loader) {
+    uint32_t count = loader->graph->initializer_count;
+
+    loader->start = connx_clock();
+    loader->thread_count = connx_Thread_alloc(count < LOADER_THREAD_COUNT ? count : LOADER_THREAD_COUNT,
+                                              loader->threads);
+
+    for(uint32_t i = 0; i < loader->thread_count; i++) {
+        connx_Thread_run(loader->threads[i], Loader_run, loader);
+    }
+}
+
+static void Loader_finish(Loader* loader) {
+    Loader_run(loader);
+
+    connx_Thread_join(loader->thread_count, loader->threads);
+    connx_Thread_free(loader->thread_count, loader->threads);
+}
+
+static int parse_Graph_text(connx_Graph* graph, char* text, Loader* loader) {
     char* token = text;
 
     // prase value_info
     check_keyword(token, "value_info");
 
-    graph->value_info_count = next_integer(token);
-    graph->value_infos = connx_alloc(sizeof(connx_Tensor*) * (graph->value_info_count + 1)); // 0 is null
-    if(graph->value_infos == NULL) {
-        connx_error("Out of memory\n");
-        return CONNX_NOT_ENOUGH_MEMORY;
-    }
+    graph->value_info_count = next_integer(token); // 0 is null
 
     // prase initializer
     check_keyword(token, "initializer");
 
     graph->initializer_count = next_integer(token);
     graph->initializers = connx_alloc(sizeof(connx_Tensor*) * graph->initializer_count);
-    if(graph->initializers == NULL) {
+    graph->mappings = connx_alloc(sizeof(void*) * graph->initializer_count);
+    graph->mapping_sizes = connx_alloc(sizeof(uint32_t) * graph->initializer_count);
+    if(graph->initializers == NULL || graph->mappings == NULL || graph->mapping_sizes == NULL) {
         connx_error("Out of memory\n");
         return CONNX_NOT_ENOUGH_MEMORY;
     }
 
-    for(uint32_t i = 0; i < graph->initializer_count; i++) {
-        connx_Tensor* tensor;
-
-        int ret = parse_initializer(&tensor, graph->id, i + 1);
-        if(ret != CONNX_OK) {
-            return ret;
-        }
-
-        graph->initializers[i] = tensor;
-    }
+    Loader_start(loader);
 
     // prase output
     check_keyword(token, "output");
@@ -282,17 +828,15 @@ static int parse_Graph(connx_Graph* graph, char* text) {
         }
 
         // Find operator for op_type
-        for(uint32_t i = 0; connx_opset_names[i] != NULL; i++) {
-            if(strcmp(node->op_type, connx_opset_names[i]) == 0) {
-                node->op = connx_opset_ops[i];
-                break;
-            }
-        }
-
-        if(node->op == NULL) {
+        int32_t op = find_operator(node->op_type);
+        if(op < 0) {
             connx_error("Operator %s is not supported yet.\n", node->op_type);
             return CONNX_NOT_SUPPORTED_OPERATOR;
         }
+        node->op = connx_opset_ops[op];
+        node->infer = connx_opset_infers[op];
+        node->can_fuse = connx_opset_can_fuses[op];
+        node->fuse = connx_opset_fuses[op];
 
         node->output_count = next_integer(token);
         node->input_count = next_integer(token);
@@ -424,66 +968,333 @@ static int parse_Graph(connx_Graph* graph, char* text) {
     return CONNX_OK;
 }
 
+static int parse_Graph(connx_Graph* graph, char* text) {
+    Loader loader = {graph, 0, CONNX_OK, 0, 0, 0};
+
+    int ret = parse_Graph_text(graph, text, &loader);
+
+    // Wait for the initializers even though parsing is failed, the workers refer the graph
+    uint64_t wait = connx_clock();
+    if(loader.start != 0) {
+        if(ret != CONNX_OK) {
+            __atomic_store_n(&loader.next, graph->initializer_count, __ATOMIC_RELAXED);
+        }
+
+        Loader_finish(&loader);
+
+        graph->model->load_time.initializer += loader.end - loader.start;
+    }
+    graph->model->load_time.wait += connx_clock() - wait;
+
+    return ret != CONNX_OK ? ret : loader.ret;
+}
+
+/**
+ * Count consumers of each value_info. A graph output has one more consumer (the caller) so that it is never
+ * released while the graph is running.
+ */
+static int count_uses(connx_Graph* graph) {
+    graph->use_counts = connx_alloc(sizeof(uint32_t) * (graph->value_info_count + 1));
+    if(graph->use_counts == NULL) {
+        connx_error("Out of memory\n");
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+
+    for(uint32_t i = 0; i < graph->node_count; i++) {
+        connx_Node* node = graph->nodes[i];
+
+        for(uint32_t j = 0; j < node->input_count; j++) {
+            graph->use_counts[node->inputs[j]]++;
+        }
+    }
+
+    for(uint32_t i = 0; i < graph->output_count; i++) {
+        graph->use_counts[graph->outputs[i]]++;
+    }
+
+    return CONNX_OK;
+}
+
+/**
+ * Node j depends on node i when j consumes an output of i. Nodes are sorted in topological order in the model,
+ * so the predecessors of a node always come before it.
+ */
+static int build_dag(connx_Graph* graph) {
+    uint32_t* producers = connx_alloc(sizeof(uint32_t) * (graph->value_info_count + 1)); // node index + 1
+    uint32_t* visits = connx_alloc(sizeof(uint32_t) * (graph->node_count + 1));          // last successor + 1
+    uint32_t* levels = connx_alloc(sizeof(uint32_t) * (graph->node_count + 1));
+    graph->dependency_counts = connx_alloc(sizeof(uint32_t) * (graph->node_count + 1));
+    graph->successor_offsets = connx_alloc(sizeof(uint32_t) * (graph->node_count + 1));
+
+    int ret = CONNX_OK;
+
+    if(producers == NULL || visits == NULL || levels == NULL || graph->dependency_counts == NULL ||
+       graph->successor_offsets == NULL) {
+        connx_error("Out of memory\n");
+        ret = CONNX_NOT_ENOUGH_MEMORY;
+        goto done;
+    }
+
+    // Count the edges, an edge is counted once even though the nodes share many values
+    uint32_t edge_count = 0;
+    for(uint32_t i = 0; i < graph->node_count; i++) {
+        connx_Node* node = graph->nodes[i];
+
+        for(uint32_t j = 0; j < node->input_count; j++) {
+            uint32_t producer = producers[node->inputs[j]];
+            if(producer != 0 && visits[producer - 1] != i + 1) {
+                visits[producer - 1] = i + 1;
+                graph->dependency_counts[i]++;
+                graph->successor_offsets[producer - 1]++;
+                edge_count++;
+            }
+        }
+
+        for(uint32_t j = 0; j < node->output_count; j++) {
+            producers[node->outputs[j]] = i + 1;
+        }
+    }
+
+    graph->successors = connx_alloc(sizeof(uint32_t) * (edge_count + 1));
+    if(graph->successors == NULL) {
+        connx_error("Out of memory\n");
+        ret = CONNX_NOT_ENOUGH_MEMORY;
+        goto done;
+    }
+
+    // Convert successor counts to the end of each range, the ranges are filled backward to their beginning
+    for(uint32_t i = 1; i <= graph->node_count; i++) {
+        graph->successor_offsets[i] += graph->successor_offsets[i - 1];
+    }
+
+    for(uint32_t i = 0; i < graph->node_count; i++) {
+        visits[i] = 0;
+    }
+
+    uint32_t max_level = 0;
+    for(uint32_t i = 0; i < graph->node_count; i++) {
+        connx_Node* node = graph->nodes[i];
+
+        for(uint32_t j = 0; j < node->input_count; j++) {
+            uint32_t producer = producers[node->inputs[j]];
+            if(producer != 0 && producer - 1 < i && visits[producer - 1] != i + 1) {
+                visits[producer - 1] = i + 1;
+                graph->successors[--graph->successor_offsets[producer - 1]] = i;
+
+                if(levels[producer - 1] + 1 > levels[i]) {
+                    levels[i] = levels[producer - 1] + 1;
+                }
+            }
+        }
+
+        if(levels[i] > max_level) {
+            max_level = levels[i];
+        }
+    }
+
+    // The level of a node is the length of the longest path from the nodes which have no dependency
+    for(uint32_t i = 0; i <= max_level; i++) {
+        visits[i] = 0;
+    }
+
+    graph->width = 1;
+    for(uint32_t i = 0; i < graph->node_count; i++) {
+        if(++visits[levels[i]] > graph->width) {
+            graph->width = visits[levels[i]];
+        }
+    }
+
+done:
+    if(producers != NULL) {
+        connx_free(producers);
+    }
+
+    if(visits != NULL) {
+        connx_free(visits);
+    }
+
+    if(levels != NULL) {
+        connx_free(levels);
+    }
+
+    return ret;
+}
+
+// Run the prepare function of each node, the nodes of the operators without it keep NULL plan
+static int prepare_nodes(connx_Graph* graph) {
+    for(uint32_t i = 0; i < graph->node_count; i++) {
+        connx_Node* node = graph->nodes[i];
+        CONNX_PREPARE prepare = connx_opset_prepares[find_operator(node->op_type)];
+
+        if(prepare != NULL) {
+            int ret = prepare(graph, node);
+            if(ret != CONNX_OK) {
+                return ret;
+            }
+        }
+    }
+
+    return CONNX_OK;
+}
+
 int connx_Graph_init(connx_Graph* graph, connx_Model* model, uint32_t graph_id) {
     graph->model = model;
     graph->id = graph_id;
+    connx_Lock_init(&graph->lock);
+
+    int ret;
+    uint64_t start = connx_clock();
+    uint64_t wait = model->load_time.wait;
+
+    if(model->binary != NULL) {
+        ret = parse_binary_Graph(graph);
+    } else {
+        // Parse value_info
+        char name[256];
+        snprintf(name, 256, "%u.text", graph_id);
+
+        void* text = connx_load(name);
+        if(text == NULL) {
+            return CONNX_RESOURCE_NOT_FOUND;
+        }
 
-    // Parse value_info
-    char name[256];
-    snprintf(name, 256, "%u.text", graph_id);
+        ret = parse_Graph(graph, text);
+        connx_unload(text);
+    }
 
-    void* text = connx_load(name);
-    int ret = parse_Graph(graph, text);
-    connx_unload(text);
+    model->load_time.graph += connx_clock() - start - (model->load_time.wait - wait);
 
     if(ret != CONNX_OK) {
         return ret;
     }
 
+    start = connx_clock();
+
+    // Nodes are prepared before the optimization which runs them
+    ret = prepare_nodes(graph);
+    if(ret == CONNX_OK) {
+        ret = connx_Graph_optimize(graph);
+    }
+
+    if(ret == CONNX_OK) {
+        ret = count_uses(graph);
+    }
+
+    if(ret == CONNX_OK) {
+        ret = build_dag(graph);
+    }
+
+    if(ret == CONNX_OK) {
+        ret = connx_Plan_init(&graph->plan, graph);
+    }
+
+    // Types which depend on the initializers only, the rest are inferred when the graph runs
+    if(ret == CONNX_OK) {
+        ret = connx_Graph_infer(graph, 0, NULL);
+    }
+
+    model->load_time.analysis += connx_clock() - start;
+
+    return ret;
+}
+
+int connx_Node_set_op_type(connx_Graph* graph, connx_Node* node, char* op_type) {
+    int32_t op = find_operator(op_type);
+    if(op < 0) {
+        return CONNX_NOT_SUPPORTED_OPERATOR;
+    }
+
+    char* str = _strdup(op_type);
+    if(str == NULL) {
+        connx_error("Out of memory\n");
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+
+    connx_free(node->op_type);
+    node->op_type = str;
+    node->op = connx_opset_ops[op];
+    node->infer = connx_opset_infers[op];
+    node->can_fuse = connx_opset_can_fuses[op];
+    node->fuse = connx_opset_fuses[op];
+
+    if(node->plan != NULL) {
+        connx_free(node->plan);
+        node->plan = NULL;
+    }
+
+    CONNX_PREPARE prepare = connx_opset_prepares[op];
+    return prepare != NULL ? prepare(graph, node) : CONNX_OK;
+}
+
+int connx_Node_destroy(connx_Node* node) {
+    if(node->op_type != NULL) {
+        connx_free(node->op_type);
+    }
+
+    if(node->plan != NULL) {
+        connx_free(node->plan);
+    }
+
+    if(node->attributes != NULL) {
+        for(uint32_t i = 0; i < node->attribute_count; i++) {
+            if(node->attributes[i] != NULL) {
+                connx_free(node->attributes[i]);
+            }
+        }
+        connx_free(node->attributes);
+    }
+
+    if(node->inputs != NULL) {
+        connx_free(node->inputs);
+    }
+
+    if(node->outputs != NULL) {
+        connx_free(node->outputs);
+    }
+
+    connx_free(node);
+
     return CONNX_OK;
 }
 
 int connx_Graph_destroy(connx_Graph* graph) {
+    connx_Plan_destroy(&graph->plan);
+    connx_Lock_destroy(&graph->lock);
+
     if(graph->nodes != NULL) {
         for(uint32_t i = 0; i < graph->node_count; i++) {
             if(graph->nodes[i] != NULL) {
-                connx_Node* node = graph->nodes[i];
-                if(node->op_type != NULL) {
-                    connx_free(node->op_type);
-                }
-
-                if(node->attributes != NULL) {
-                    for(uint32_t j = 0; j < node->attribute_count; j++) {
-                        if(node->attributes[j] != NULL) {
-                            connx_free(node->attributes[j]);
-                        }
-                    }
-                    connx_free(node->attributes);
-                }
-
-                if(node->inputs != NULL) {
-                    connx_free(node->inputs);
-                }
-
-                if(node->outputs != NULL) {
-                    connx_free(node->outputs);
-                }
-
-                connx_free(node);
+                connx_Node_destroy(graph->nodes[i]);
             }
         }
         connx_free(graph->nodes);
     }
 
+    if(graph->use_counts != NULL) {
+        connx_free(graph->use_counts);
+    }
+
     if(graph->value_infos != NULL) {
-        for(uint32_t i = 0; i < graph->value_info_count; i++) {
-            if(graph->value_infos[i] != NULL) {
-                connx_Tensor_unref(graph->value_infos[i]);
+        for(uint32_t i = 0; i <= graph->value_info_count; i++) {
+            if(graph->value_infos[i].shape != NULL) {
+                connx_free(graph->value_infos[i].shape);
             }
         }
         connx_free(graph->value_infos);
     }
 
+    if(graph->dependency_counts != NULL) {
+        connx_free(graph->dependency_counts);
+    }
+
+    if(graph->successor_offsets != NULL) {
+        connx_free(graph->successor_offsets);
+    }
+
+    if(graph->successors != NULL) {
+        connx_free(graph->successors);
+    }
+
     if(graph->outputs != NULL) {
         connx_free(graph->outputs);
     }
@@ -501,65 +1312,19 @@ int connx_Graph_destroy(connx_Graph* graph) {
         connx_free(graph->initializers);
     }
 
-    return CONNX_OK;
-}
-
-int connx_Graph_run(connx_Graph* graph, uint32_t input_count, connx_Tensor** inputs, uint32_t* output_count,
-                    connx_Tensor** outputs) {
-    // Set inputs
-    input_count = input_count < graph->input_count ? input_count : graph->input_count;
-
-    for(uint32_t i = 0; i < input_count; i++) {
-        uint32_t id = graph->inputs[i];
-        graph->value_infos[id] = inputs[i];
-    }
-
-    // Initialize value_infos
-    for(uint32_t i = 0; i < graph->initializer_count; i++) {
-        if(graph->value_infos[i + 1] == NULL) {
-            graph->value_infos[i + 1] = connx_Tensor_copy(graph->initializers[i]);
-        }
-    }
-
-    // Execute operators
-    for(uint32_t i = 0; i < graph->node_count; i++) {
-        connx_Node* node = graph->nodes[i];
-        int ret = node->op(graph, node->output_count, node->outputs, node->input_count, node->inputs, node->attributes);
-        if(ret != CONNX_OK) {
-            return ret;
+    // Initializers point into the mappings
+    if(graph->mappings != NULL) {
+        for(uint32_t i = 0; i < graph->initializer_count; i++) {
+            if(graph->mappings[i] != NULL) {
+                connx_unmap(graph->mappings[i], graph->mapping_sizes[i]);
+            }
         }
+        connx_free(graph->mappings);
     }
 
-    // Set outputs
-    *output_count = *output_count < graph->output_count ? *output_count : graph->output_count;
-    for(uint32_t i = 0; i < *output_count; i++) {
-        uint32_t id = graph->outputs[i];
-        outputs[i] = graph->value_infos[id];
-        graph->value_infos[id] = NULL;
-    }
-
-    // Clean value_infos
-    for(uint32_t i = 0; i < graph->value_info_count; i++) {
-        if(graph->value_infos[i] != NULL) {
-            connx_Tensor_unref(graph->value_infos[i]);
-            graph->value_infos[i] = NULL;
-        }
+    if(graph->mapping_sizes != NULL) {
+        connx_free(graph->mapping_sizes);
     }
 
     return CONNX_OK;
 }
-
-connx_Tensor* connx_Graph_get(connx_Graph* graph, uint32_t id) {
-    return graph->value_infos[id];
-}
-
-void connx_Graph_set(connx_Graph* graph, uint32_t id, connx_Tensor* tensor) {
-    if(graph->value_infos[id] == tensor)
-        return;
-
-    if(graph->value_infos[id] != NULL) {
-        connx_Tensor_unref(graph->value_infos[id]);
-    }
-
-    graph->value_infos[id] = tensor;
-}
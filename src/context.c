@@ -0,0 +1,476 @@
+#include <string.h>
+#include <connx/accel.h>
+#include <connx/connx.h>
+#include <connx/hal.h>
+
+int connx_Context_init(connx_Context* context, connx_Graph* graph) {
+    uint32_t count = graph->value_info_count + 1; // 0 is null
+
+    context->graph = graph;
+
+    context->value_infos = connx_alloc(sizeof(connx_Tensor*) * count);
+    context->remain_counts = connx_alloc(sizeof(uint32_t) * count);
+    context->dependency_counts = connx_alloc(sizeof(uint32_t) * (graph->node_count + 1));
+    context->slots = connx_alloc(sizeof(uint32_t) * count);
+    context->offsets = connx_alloc(sizeof(uint32_t) * count);
+
+    if(context->value_infos == NULL || context->remain_counts == NULL || context->dependency_counts == NULL ||
+       context->slots == NULL || context->offsets == NULL) {
+        connx_error("Out of memory\n");
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+
+    context->plan_version = 0;
+    context->arena = NULL;
+    context->arena_size = 0;
+    context->live_bytes = 0;
+    context->peak_bytes = 0;
+    context->is_sequential = false;
+
+    return CONNX_OK;
+}
+
+static void clean(connx_Context* context) {
+    for(uint32_t i = 0; i <= context->graph->value_info_count; i++) {
+        if(context->value_infos[i] != NULL) {
+            connx_Tensor_unref(context->value_infos[i]);
+            context->value_infos[i] = NULL;
+        }
+    }
+}
+
+int connx_Context_destroy(connx_Context* context) {
+    if(context->value_infos != NULL) {
+        clean(context);
+        connx_free(context->value_infos);
+    }
+
+    if(context->remain_counts != NULL) {
+        connx_free(context->remain_counts);
+    }
+
+    if(context->dependency_counts != NULL) {
+        connx_free(context->dependency_counts);
+    }
+
+    if(context->slots != NULL) {
+        connx_free(context->slots);
+    }
+
+    if(context->offsets != NULL) {
+        connx_free(context->offsets);
+    }
+
+    if(context->arena != NULL) {
+        connx_free(context->arena);
+    }
+
+    return CONNX_OK;
+}
+
+// Take the latest memory plan of the graph, no tensor refers the arena between runs
+static int sync_plan(connx_Context* context) {
+    connx_Graph* graph = context->graph;
+    connx_Plan* plan = &graph->plan;
+    int ret = CONNX_OK;
+
+    connx_Lock_lock(&graph->lock);
+
+    if(context->plan_version != plan->version) {
+        if(plan->arena_size > context->arena_size) {
+            if(context->arena != NULL) {
+                connx_free(context->arena);
+            }
+
+            context->arena = connx_alloc(plan->arena_size);
+            context->arena_size = context->arena != NULL ? plan->arena_size : 0;
+        }
+
+        if(context->arena != NULL || plan->arena_size == 0) {
+            memcpy(context->slots, plan->slots, sizeof(uint32_t) * plan->value_count);
+            memcpy(context->offsets, plan->offsets, sizeof(uint32_t) * plan->value_count);
+            context->plan_version = plan->version;
+        } else {
+            connx_error("Out of memory\n");
+            ret = CONNX_NOT_ENOUGH_MEMORY;
+        }
+    }
+
+    connx_Lock_unlock(&graph->lock);
+
+    return ret;
+}
+
+static void add_live_bytes(connx_Context* context, uint32_t size) {
+    uint32_t live_bytes = __atomic_add_fetch(&context->live_bytes, size, __ATOMIC_RELAXED);
+    uint32_t peak_bytes = __atomic_load_n(&context->peak_bytes, __ATOMIC_RELAXED);
+
+    while(live_bytes > peak_bytes && !__atomic_compare_exchange_n(&context->peak_bytes, &peak_bytes, live_bytes, true,
+                                                                  __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+// Unref a tensor, the buffers which are freed by it are not alive anymore
+static void release(connx_Context* context, connx_Tensor* tensor) {
+    for(connx_Tensor* t = tensor; t != NULL; t = t->parent) {
+        // Initializers are referenced by the other contexts too
+        connx_Lock_lock(&t->lock);
+        int32_t ref_count = t->ref_count;
+        connx_Lock_unlock(&t->lock);
+
+        if(ref_count != 1) {
+            break;
+        }
+
+        if(t->parent == NULL) {
+            __atomic_sub_fetch(&context->live_bytes, t->size, __ATOMIC_RELAXED);
+        }
+    }
+
+    connx_Tensor_unref(tensor);
+}
+
+// Whether tensor is an input of the node, which the node wrote its output over
+static bool is_input(connx_Context* context, connx_Node* node, connx_Tensor* tensor) {
+    for(uint32_t i = 0; i < node->input_count; i++) {
+        if(context->value_infos[node->inputs[i]] == tensor) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Run a node and release the inputs after their last consumer
+static int execute(connx_Context* context, connx_Node* node) {
+    int ret = node->op(context, node->output_count, node->outputs, node->input_count, node->inputs, node->attributes,
+                      node->plan);
+    if(ret != CONNX_OK) {
+        return ret;
+    }
+
+    for(uint32_t i = 0; i < node->output_count; i++) {
+        connx_Tensor* tensor = context->value_infos[node->outputs[i]];
+        if(tensor != NULL && tensor->parent == NULL && !is_input(context, node, tensor)) {
+            add_live_bytes(context, tensor->size);
+        }
+    }
+
+    for(uint32_t i = 0; i < node->input_count; i++) {
+        uint32_t id = node->inputs[i];
+        if(__atomic_sub_fetch(&context->remain_counts[id], 1, __ATOMIC_ACQ_REL) == 0 &&
+           context->value_infos[id] != NULL) {
+            release(context, context->value_infos[id]);
+            context->value_infos[id] = NULL;
+        }
+    }
+
+    return CONNX_OK;
+}
+
+/**
+ * Work stealing deque of the ready nodes. The owner pushes and pops nodes at the bottom and the other workers
+ * steal nodes from the top. Each node is pushed once in a run, so the array never overflows.
+ */
+typedef struct _Deque {
+    connx_Lock lock;
+    uint32_t top;
+    uint32_t bottom;
+    uint32_t* nodes;
+} Deque;
+
+static void Deque_push(Deque* deque, uint32_t node) {
+    connx_Lock_lock(&deque->lock);
+    deque->nodes[deque->bottom++] = node;
+    connx_Lock_unlock(&deque->lock);
+}
+
+static bool Deque_pop(Deque* deque, uint32_t* node) {
+    bool is_popped = false;
+
+    connx_Lock_lock(&deque->lock);
+    if(deque->top < deque->bottom) {
+        *node = deque->nodes[--deque->bottom];
+        is_popped = true;
+    }
+    connx_Lock_unlock(&deque->lock);
+
+    return is_popped;
+}
+
+static bool Deque_steal(Deque* deque, uint32_t* node) {
+    bool is_stolen = false;
+
+    connx_Lock_lock(&deque->lock);
+    if(deque->top < deque->bottom) {
+        *node = deque->nodes[deque->top++];
+        is_stolen = true;
+    }
+    connx_Lock_unlock(&deque->lock);
+
+    return is_stolen;
+}
+
+typedef struct _Scheduler {
+    connx_Context* context;
+    uint32_t worker_count; // including the caller thread
+    Deque* deques;         // deque of each worker
+    uint32_t done_count;   // number of executed nodes
+    int ret;               // error of the first failed node
+} Scheduler;
+
+typedef struct _Worker {
+    Scheduler* scheduler;
+    uint32_t id;
+} Worker;
+
+static void Worker_run(void* arg) {
+    Worker* worker = arg;
+    Scheduler* scheduler = worker->scheduler;
+    connx_Context* context = scheduler->context;
+    connx_Graph* graph = context->graph;
+    Deque* deque = &scheduler->deques[worker->id];
+
+    while(__atomic_load_n(&scheduler->done_count, __ATOMIC_ACQUIRE) < graph->node_count &&
+          __atomic_load_n(&scheduler->ret, __ATOMIC_RELAXED) == CONNX_OK) {
+        uint32_t id;
+        bool is_found = Deque_pop(deque, &id);
+
+        for(uint32_t i = 1; !is_found && i < scheduler->worker_count; i++) {
+            is_found = Deque_steal(&scheduler->deques[(worker->id + i) % scheduler->worker_count], &id);
+        }
+
+        if(!is_found) {
+            connx_Thread_yield();
+            continue;
+        }
+
+        int ret = execute(context, graph->nodes[id]);
+        if(ret != CONNX_OK) {
+            int expected = CONNX_OK;
+            __atomic_compare_exchange_n(&scheduler->ret, &expected, ret, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+            break;
+        }
+
+        // The worker which resolves the last dependency of a successor runs it, unless the others steal it
+        for(uint32_t i = graph->successor_offsets[id]; i < graph->successor_offsets[id + 1]; i++) {
+            uint32_t successor = graph->successors[i];
+            if(__atomic_sub_fetch(&context->dependency_counts[successor], 1, __ATOMIC_ACQ_REL) == 0) {
+                Deque_push(deque, successor);
+            }
+        }
+
+        __atomic_add_fetch(&scheduler->done_count, 1, __ATOMIC_RELEASE);
+    }
+}
+
+// Run the nodes in the DAG order by the caller and the threads
+static int schedule(connx_Context* context, uint32_t thread_count, connx_Thread* threads) {
+    connx_Graph* graph = context->graph;
+    uint32_t worker_count = thread_count + 1;
+
+    uint32_t* nodes = connx_alloc(sizeof(uint32_t) * graph->node_count * worker_count);
+    if(nodes == NULL) {
+        connx_error("Out of memory\n");
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+
+    Deque deques[worker_count];
+    Worker workers[worker_count];
+    Scheduler scheduler = {context, worker_count, deques, 0, CONNX_OK};
+
+    for(uint32_t i = 0; i < worker_count; i++) {
+        connx_Lock_init(&deques[i].lock);
+        deques[i].top = 0;
+        deques[i].bottom = 0;
+        deques[i].nodes = nodes + i * graph->node_count;
+
+        workers[i].scheduler = &scheduler;
+        workers[i].id = i;
+    }
+
+    // Deal the nodes which depend on nothing to the workers
+    memcpy(context->dependency_counts, graph->dependency_counts, sizeof(uint32_t) * graph->node_count);
+
+    for(uint32_t i = 0, worker = 0; i < graph->node_count; i++) {
+        if(context->dependency_counts[i] == 0) {
+            Deque_push(&deques[worker], i);
+            worker = (worker + 1) % worker_count;
+        }
+    }
+
+    for(uint32_t i = 0; i < thread_count; i++) {
+        connx_Thread_run(threads[i], Worker_run, &workers[i + 1]);
+    }
+
+    Worker_run(&workers[0]);
+
+    connx_Thread_join(thread_count, threads);
+
+    for(uint32_t i = 0; i < worker_count; i++) {
+        connx_Lock_destroy(&deques[i].lock);
+    }
+
+    connx_free(nodes);
+
+    return scheduler.ret;
+}
+
+int connx_Context_run(connx_Context* context, uint32_t input_count, connx_Tensor** inputs, uint32_t* output_count,
+                      connx_Tensor** outputs) {
+    connx_Graph* graph = context->graph;
+
+    // Reserve the buffers of new input types in the plan before the plan is copied
+    int ret = connx_Graph_infer(graph, input_count, inputs);
+    if(ret == CONNX_OK) {
+        ret = sync_plan(context);
+    }
+
+    if(ret != CONNX_OK) {
+        return ret;
+    }
+
+    // Set inputs
+    input_count = input_count < graph->input_count ? input_count : graph->input_count;
+
+    context->live_bytes = 0;
+    context->peak_bytes = 0;
+
+    for(uint32_t i = 0; i < input_count; i++) {
+        uint32_t id = graph->inputs[i];
+        context->value_infos[id] = inputs[i];
+        context->live_bytes += inputs[i]->size;
+    }
+
+    // Initialize value_infos
+    // Initializers are shared read-only between runs, operators must never write to their inputs
+    for(uint32_t i = 0; i < graph->initializer_count; i++) {
+        if(context->value_infos[i + 1] == NULL) {
+            connx_Tensor_ref(graph->initializers[i]);
+            context->value_infos[i + 1] = graph->initializers[i];
+        }
+    }
+
+    memcpy(context->remain_counts, graph->use_counts, sizeof(uint32_t) * (graph->value_info_count + 1));
+
+    // Execute operators, on the idle threads of the pool as many as the DAG can use
+    connx_Thread threads[graph->width];
+    uint32_t thread_count = 0;
+    if(!context->is_sequential && graph->width > 1) {
+        thread_count = connx_Thread_alloc(graph->width - 1, threads);
+    }
+
+    if(thread_count > 0) {
+        ret = schedule(context, thread_count, threads);
+        connx_Thread_free(thread_count, threads);
+    } else {
+        for(uint32_t i = 0; i < graph->node_count && ret == CONNX_OK; i++) {
+            ret = execute(context, graph->nodes[i]);
+        }
+    }
+
+    if(ret != CONNX_OK) {
+        clean(context);
+        return ret;
+    }
+
+    // Set outputs
+    *output_count = *output_count < graph->output_count ? *output_count : graph->output_count;
+    for(uint32_t i = 0; i < *output_count; i++) {
+        uint32_t id = graph->outputs[i];
+        outputs[i] = context->value_infos[id];
+        context->value_infos[id] = NULL;
+    }
+
+    // Clean value_infos which are not consumed by any node
+    clean(context);
+
+    // Replan the arena if some buffers did not fit in their slots
+    connx_Lock_lock(&graph->lock);
+    if(graph->plan.is_dirty) {
+        ret = connx_Plan_update(&graph->plan);
+    }
+    connx_Lock_unlock(&graph->lock);
+
+    return ret;
+}
+
+connx_Tensor* connx_Context_get(connx_Context* context, uint32_t id) {
+    return context->value_infos[id];
+}
+
+void connx_Context_set(connx_Context* context, uint32_t id, connx_Tensor* tensor) {
+    if(context->value_infos[id] == tensor)
+        return;
+
+    if(context->value_infos[id] != NULL) {
+        connx_Tensor_unref(context->value_infos[id]);
+    }
+
+    context->value_infos[id] = tensor;
+}
+
+/**
+ * Allocate the output tensor of value_info id. The buffer is placed in the arena slot of the value_info when the
+ * memory plan has one large enough, otherwise the tensor is allocated from the heap and the plan is updated after
+ * the run.
+ */
+connx_Tensor* connx_Context_alloc(connx_Context* context, uint32_t id, connx_DataType dtype, int32_t ndim,
+                                  int32_t* shape) {
+    connx_Plan* plan = &context->graph->plan;
+    uint32_t root = plan->roots != NULL ? plan->roots[id] : 0; // not planned yet while the graph is optimized
+
+    if(root == 0) {
+        return connx_Tensor_alloc(dtype, ndim, shape);
+    }
+
+    uint32_t size = connx_DataType_size(dtype) * connx_Int32_product(ndim, shape);
+
+    if(size <= context->slots[root]) {
+        void* buffer = context->arena + context->offsets[root];
+        memset(buffer, 0, size);
+
+        return connx_Tensor_wrap(dtype, ndim, shape, buffer);
+    }
+
+    connx_Lock_lock(&context->graph->lock);
+    if(size > plan->sizes[root]) {
+        plan->sizes[root] = size;
+        plan->is_dirty = true;
+    }
+    connx_Lock_unlock(&context->graph->lock);
+
+    return connx_Tensor_alloc(dtype, ndim, shape);
+}
+
+connx_Tensor* connx_Context_alloc_inplace(connx_Context* context, uint32_t id, connx_DataType dtype, int32_t ndim,
+                                          int32_t* shape) {
+    connx_Plan* plan = &context->graph->plan;
+    uint32_t begin = 0;
+    uint32_t end = 0;
+    if(plan->roots != NULL && plan->roots[id] != 0) {
+        begin = plan->inplace_offsets[plan->begins[id]];
+        end = plan->inplace_offsets[plan->begins[id] + 1];
+    }
+
+    for(uint32_t i = begin; i < end; i++) {
+        connx_Tensor* tensor = context->value_infos[plan->inplaces[i]];
+
+        // A view or a tensor referred by a view shares the buffer
+        if(tensor == NULL || tensor->parent != NULL || tensor->dtype != dtype || tensor->ndim != ndim ||
+           memcmp(tensor->shape, shape, sizeof(int32_t) * ndim) != 0) {
+            continue;
+        }
+
+        connx_Lock_lock(&tensor->lock);
+        int32_t ref_count = tensor->ref_count;
+        connx_Lock_unlock(&tensor->lock);
+
+        if(ref_count == 1) {
+            connx_Tensor_ref(tensor);
+            return tensor;
+        }
+    }
+
+    return connx_Context_alloc(context, id, dtype, ndim, shape);
+}
@@ -0,0 +1,218 @@
+#include <string.h>
+#include <connx/accel.h>
+#include <connx/connx.h>
+#include <connx/hal.h>
+
+/**
+ * Static shape inference
+ *
+ * Types of the value_infos are propagated from the graph inputs and the initializers through the nodes in the model
+ * order by the infer functions of the operators. A value_info stays unknown when a type of the inputs of its producer
+ * is unknown or the operator has no infer function.
+ *
+ * The model doesn't record the types of the graph inputs, so only the values which are derived from the initializers
+ * are known when the graph is loaded. The graph is inferred again by connx_Context_run whenever it runs with the
+ * inputs of new types, before the run, so the buffers of the run are reserved in the memory plan in advance instead
+ * of being discovered by the run.
+ */
+static void reset(connx_ValueInfo* value_info) {
+    if(value_info->shape != NULL) {
+        connx_free(value_info->shape);
+    }
+
+    value_info->dtype = CONNX_UNDEFINED;
+    value_info->ndim = 0;
+    value_info->shape = NULL;
+}
+
+connx_ValueInfo* connx_Graph_get_value_info(connx_Graph* graph, uint32_t id) {
+    connx_ValueInfo* value_info = &graph->value_infos[id];
+    return value_info->dtype != CONNX_UNDEFINED ? value_info : NULL;
+}
+
+int connx_Graph_set_value_info(connx_Graph* graph, uint32_t id, connx_DataType dtype, int32_t ndim, int32_t* shape) {
+    connx_ValueInfo* value_info = &graph->value_infos[id];
+    reset(value_info);
+
+    value_info->shape = connx_alloc(sizeof(int32_t) * (ndim + 1)); // a scalar has no dimension
+    if(value_info->shape == NULL) {
+        connx_error("Out of memory\n");
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+
+    memcpy(value_info->shape, shape, sizeof(int32_t) * ndim);
+    value_info->dtype = dtype;
+    value_info->ndim = ndim;
+
+    return CONNX_OK;
+}
+
+/**
+ * Initializers are constant. Models of old IR versions list the initializers in the graph inputs too, as the default
+ * values of the inputs, but overriding an initializer is not supported.
+ */
+connx_Tensor* connx_Graph_get_constant(connx_Graph* graph, uint32_t id) {
+    if(id == 0 || id > graph->initializer_count) {
+        return NULL;
+    }
+
+    return graph->initializers[id - 1];
+}
+
+int connx_infer_elementwise(connx_Graph* graph, connx_Node* node) {
+    connx_ValueInfo* A = connx_Graph_get_value_info(graph, node->inputs[0]);
+
+    int32_t ndim = A->ndim;
+    for(uint32_t i = 1; i < node->input_count; i++) {
+        connx_ValueInfo* B = connx_Graph_get_value_info(graph, node->inputs[i]);
+        if(B->ndim > ndim) {
+            ndim = B->ndim;
+        }
+    }
+
+    // Dimensions are aligned to the last one, a dimension of 1 is broadcast to the others
+    int32_t shape[ndim + 1];
+    for(int32_t i = 0; i < ndim; i++) {
+        shape[i] = 1;
+    }
+
+    for(uint32_t i = 0; i < node->input_count; i++) {
+        connx_ValueInfo* B = connx_Graph_get_value_info(graph, node->inputs[i]);
+        int32_t* dims = shape + ndim - B->ndim;
+
+        for(int32_t j = 0; j < B->ndim; j++) {
+            if(dims[j] == 1) {
+                dims[j] = B->shape[j];
+            } else if(B->shape[j] != 1 && B->shape[j] != dims[j]) {
+                connx_error("%s: Shapes of the inputs cannot be broadcast.\n", node->op_type);
+                return CONNX_TENSOR_SHAPE_NOT_MATCHING;
+            }
+        }
+    }
+
+    return connx_Graph_set_value_info(graph, node->outputs[0], A->dtype, ndim, shape);
+}
+
+static bool is_inferred(connx_Graph* graph, uint32_t input_count, connx_Tensor** inputs) {
+    if(!graph->is_inferred) {
+        return false;
+    }
+
+    for(uint32_t i = 0; i < input_count; i++) {
+        connx_ValueInfo* value_info = &graph->value_infos[graph->inputs[i]];
+        connx_Tensor* input = inputs[i];
+
+        if(value_info->dtype != input->dtype || value_info->ndim != input->ndim ||
+           memcmp(value_info->shape, input->shape, sizeof(int32_t) * input->ndim) != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static int infer(connx_Graph* graph, uint32_t input_count, connx_Tensor** inputs) {
+    for(uint32_t id = 1; id <= graph->value_info_count; id++) {
+        reset(&graph->value_infos[id]);
+    }
+
+    int ret = CONNX_OK;
+
+    for(uint32_t i = 0; i < graph->initializer_count && ret == CONNX_OK; i++) {
+        connx_Tensor* initializer = graph->initializers[i];
+        ret = connx_Graph_set_value_info(graph, i + 1, initializer->dtype, initializer->ndim, initializer->shape);
+    }
+
+    for(uint32_t i = 0; i < input_count && ret == CONNX_OK; i++) {
+        ret = connx_Graph_set_value_info(graph, graph->inputs[i], inputs[i]->dtype, inputs[i]->ndim, inputs[i]->shape);
+    }
+
+    for(uint32_t i = 0; i < graph->node_count && ret == CONNX_OK; i++) {
+        connx_Node* node = graph->nodes[i];
+        if(node->infer == NULL) {
+            continue;
+        }
+
+        bool is_known = true;
+        for(uint32_t j = 0; j < node->input_count; j++) {
+            if(connx_Graph_get_value_info(graph, node->inputs[j]) == NULL) {
+                is_known = false;
+                break;
+            }
+        }
+
+        if(is_known) {
+            ret = node->infer(graph, node);
+        }
+    }
+
+    graph->is_inferred = ret == CONNX_OK;
+
+    return ret;
+}
+
+// Whether value_info id will be written over an input of its node, which has the same type
+static bool is_inplace(connx_Graph* graph, uint32_t id, connx_ValueInfo* value_info) {
+    connx_Plan* plan = &graph->plan;
+    int32_t node = plan->begins[id];
+
+    for(uint32_t i = plan->inplace_offsets[node]; i < plan->inplace_offsets[node + 1]; i++) {
+        connx_ValueInfo* input = connx_Graph_get_value_info(graph, plan->inplaces[i]);
+
+        if(input != NULL && input->dtype == value_info->dtype && input->ndim == value_info->ndim &&
+           memcmp(input->shape, value_info->shape, sizeof(int32_t) * input->ndim) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Reserve the inferred buffers in the memory plan, planned buffers only grow as connx_Context_alloc does
+static int reserve(connx_Graph* graph) {
+    connx_Plan* plan = &graph->plan;
+
+    for(uint32_t id = 1; id <= graph->value_info_count; id++) {
+        connx_ValueInfo* value_info = connx_Graph_get_value_info(graph, id);
+        uint32_t root = plan->roots[id];
+
+        if(value_info == NULL || root == 0 || is_inplace(graph, id, value_info)) {
+            continue;
+        }
+
+        uint32_t size = connx_DataType_size(value_info->dtype) * connx_Int32_product(value_info->ndim, value_info->shape);
+        if(size > plan->sizes[root]) {
+            plan->sizes[root] = size;
+            plan->is_dirty = true;
+        }
+    }
+
+    return plan->is_dirty ? connx_Plan_update(plan) : CONNX_OK;
+}
+
+int connx_Graph_infer(connx_Graph* graph, uint32_t input_count, connx_Tensor** inputs) {
+    int ret = CONNX_OK;
+
+    input_count = input_count < graph->input_count ? input_count : graph->input_count;
+
+    connx_Lock_lock(&graph->lock);
+
+    if(graph->value_infos == NULL) {
+        graph->value_infos = connx_alloc(sizeof(connx_ValueInfo) * (graph->value_info_count + 1));
+        if(graph->value_infos == NULL) {
+            connx_error("Out of memory\n");
+            ret = CONNX_NOT_ENOUGH_MEMORY;
+        }
+    }
+
+    if(ret == CONNX_OK && !is_inferred(graph, input_count, inputs)) {
+        ret = infer(graph, input_count, inputs);
+        if(ret == CONNX_OK) {
+            ret = reserve(graph);
+        }
+    }
+
+    connx_Lock_unlock(&graph->lock);
+
+    return ret;
+}
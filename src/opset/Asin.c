@@ -1,10 +1,18 @@
-#include <math.h>
 #include <connx/accel.h>
 #include <connx/connx.h>
 
-int Asin(connx_Graph* graph, uint32_t output_count, uint32_t* outputs, uint32_t input_count, uint32_t* inputs, __attribute__((unused)) void** attributes) {
-    connx_Tensor* input = connx_Graph_get(graph, inputs[0]);
-    connx_Tensor* output = connx_Tensor_alloc_like(input);
+int Asin_infer(connx_Graph* graph, connx_Node* node) {
+    return connx_infer_elementwise(graph, node);
+}
+
+int Asin(connx_Context* context, uint32_t output_count, uint32_t* outputs, uint32_t input_count, uint32_t* inputs,
+         __attribute__((unused)) void** attributes, __attribute__((unused)) void* plan) {
+    connx_Tensor* input = connx_Context_get(context, inputs[0]);
+    connx_Tensor* output =
+        connx_Context_alloc_inplace(context, outputs[0], input->dtype, input->ndim, input->shape);
+    if(output == NULL) {
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
 
     int32_t total = connx_Int32_product(input->ndim, input->shape);
 
@@ -14,22 +22,17 @@ int Asin(connx_Graph* graph, uint32_t output_count, uint32_t* outputs, uint32_t
 #undef TEMPLATE_TYPE
 #define TEMPLATE_DTYPE FLOAT32
 #define TEMPLATE_TYPE float32_t
-        case TEMPLATE_DTYPE: {
-            TEMPLATE_TYPE* input_array = input->buffer;
-            TEMPLATE_TYPE* output_array = output->buffer;
-
-            for(int32_t i = 0; i < total; i++) {
-                output_array[i] = asinf(input_array[i]);
-            }
+        case TEMPLATE_DTYPE:
+            connx_TEMPLATE_NAME_asin(total, output->buffer, input->buffer);
             break;
-        }
             TEMPLATE_END()
         default:
             connx_error("Asin: Datatype %d is not supported yet.\n", input->dtype);
+            connx_Tensor_unref(output);
             return CONNX_NOT_SUPPORTED_DATATYPE;
     }
 
-    connx_Graph_set(graph, outputs[0], output);
+    connx_Context_set(context, outputs[0], output);
 
     return CONNX_OK;
 }
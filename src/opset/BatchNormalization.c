@@ -0,0 +1,94 @@
+#include <math.h>
+#include <connx/accel.h>
+#include <connx/connx.h>
+
+// Attributes decoded by BatchNormalization_prepare
+typedef struct _BatchNormalizationPlan {
+    float32_t epsilon;
+    int32_t training_mode; // since opset 14, older models don't have it
+} BatchNormalizationPlan;
+
+int BatchNormalization_prepare(__attribute__((unused)) connx_Graph* graph, connx_Node* node) {
+    BatchNormalizationPlan* plan = connx_alloc(sizeof(BatchNormalizationPlan));
+    if(plan == NULL) {
+        connx_error("Out of memory\n");
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+    node->plan = plan;
+
+    plan->epsilon = *(float32_t*)node->attributes[0];
+    plan->training_mode = node->attribute_count > 2 ? *(int32_t*)node->attributes[2] : 0;
+
+    if(plan->training_mode != 0 || node->output_count > 1) {
+        connx_error("BatchNormalization: training mode is not supported.\n");
+        return CONNX_NOT_SUPPORTED_ATTRIBUTE;
+    }
+
+    return CONNX_OK;
+}
+
+int BatchNormalization_infer(connx_Graph* graph, connx_Node* node) {
+    connx_ValueInfo* X = connx_Graph_get_value_info(graph, node->inputs[0]);
+
+    return connx_Graph_set_value_info(graph, node->outputs[0], X->dtype, X->ndim, X->shape);
+}
+
+int BatchNormalization(connx_Context* context, uint32_t output_count, uint32_t* outputs, uint32_t input_count,
+                       uint32_t* inputs, __attribute__((unused)) void** attributes, void* plan) {
+    connx_Tensor* X = connx_Context_get(context, inputs[0]);
+    connx_Tensor* scale = connx_Context_get(context, inputs[1]);
+    connx_Tensor* B = connx_Context_get(context, inputs[2]);
+    connx_Tensor* input_mean = connx_Context_get(context, inputs[3]);
+    connx_Tensor* input_var = connx_Context_get(context, inputs[4]);
+
+    float32_t epsilon = ((BatchNormalizationPlan*)plan)->epsilon;
+
+    connx_Tensor* Y = connx_Context_alloc_inplace(context, outputs[0], X->dtype, X->ndim, X->shape);
+    if(Y == NULL) {
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+
+    int32_t batch_count = X->shape[0];
+    int32_t channel_count = X->ndim > 1 ? X->shape[1] : 1;
+    int32_t unit = X->ndim > 2 ? connx_Int32_product(X->ndim - 2, X->shape + 2) : 1;
+
+    switch(X->dtype) {
+        TEMPLATE_START(FLOAT32, FLOAT64)
+#undef TEMPLATE_DTYPE
+#undef TEMPLATE_TYPE
+#define TEMPLATE_DTYPE FLOAT32
+#define TEMPLATE_TYPE float32_t
+        case TEMPLATE_DTYPE: {
+            TEMPLATE_TYPE* X_array = X->buffer;
+            TEMPLATE_TYPE* Y_array = Y->buffer;
+            TEMPLATE_TYPE* scale_array = scale->buffer;
+            TEMPLATE_TYPE* B_array = B->buffer;
+            TEMPLATE_TYPE* mean_array = input_mean->buffer;
+            TEMPLATE_TYPE* var_array = input_var->buffer;
+
+            for(int32_t channel = 0; channel < channel_count; channel++) {
+                // y = (x - mean) / sqrt(var + epsilon) * scale + B = x * a + b
+                TEMPLATE_TYPE a = scale_array[channel] / sqrt(var_array[channel] + epsilon);
+                TEMPLATE_TYPE b = B_array[channel] - mean_array[channel] * a;
+
+                for(int32_t batch = 0; batch < batch_count; batch++) {
+                    int32_t offset = (batch * channel_count + channel) * unit;
+
+                    for(int32_t i = offset; i < offset + unit; i++) {
+                        Y_array[i] = X_array[i] * a + b;
+                    }
+                }
+            }
+            break;
+        }
+            TEMPLATE_END()
+        default:
+            connx_error("BatchNormalization: Datatype %d is not supported yet.\n", X->dtype);
+            connx_Tensor_unref(Y);
+            return CONNX_NOT_SUPPORTED_DATATYPE;
+    }
+
+    connx_Context_set(context, outputs[0], Y);
+
+    return CONNX_OK;
+}
@@ -1,15 +1,76 @@
 #include <math.h>
 #include <string.h>
-#include <strings.h> // bzero
 #include <connx/accel.h>
 #include <connx/connx.h>
 
+// Activations which Conv_fuse takes into the epilogue
+typedef enum _ConvActivation {
+    CONV_ACTIVATION_NONE,
+    CONV_ACTIVATION_RELU,
+    CONV_ACTIVATION_LEAKY_RELU,
+    CONV_ACTIVATION_SIGMOID,
+    CONV_ACTIVATION_MISH,
+} ConvActivation;
+
+// Attributes decoded by Conv_prepare
+typedef struct _ConvPlan {
+    connx_AutoPad auto_pad;
+    int32_t group;
+    ConvActivation activation; // fused by Conv_fuse
+    float32_t alpha;           // of LeakyRelu
+    int32_t feature_dim;
+    int32_t* dilations;
+    int32_t* kernel_shape;
+    int32_t* pads;   // pads of NOTSET, SAME_UPPER and SAME_LOWER are calculated from the input shape on each run
+    int32_t* strides;
+    int32_t* w_iter; // kernel iterator which is ready to run
+    connx_Tensor* winograd_W; // W which U is transformed from, NULL if the Conv is not run by Winograd
+    void* U;                  // Winograd transform of winograd_W, [group][36][feature map of the group][channel]
+    int32_t array[0];
+} ConvPlan;
+
+/**
+ * Conv is lowered to GEMM when a group has CONV_GEMM_MIN_FEATURE_MAPS feature maps or more, which share the im2col
+ * matrix of the group. The output positions are split into tiles of CONV_GEMM_TILE columns, so the im2col matrix of a
+ * tile is built right before it is multiplied by connx_gemm of the accel layer.
+ */
+#define CONV_GEMM_MIN_FEATURE_MAPS 4
+#define CONV_GEMM_TILE 256
+
+/**
+ * 2D 3x3 Conv of stride 1 and dilation 1 is run by Winograd F(4x4, 3x3) when W is an initializer, which takes 36
+ * multiplications for a 4x4 tile of the output instead of 144. The filters are transformed by Conv_prepare, and the
+ * element-wise products of a tile position over the channels are the GEMM of (feature map x channel) and
+ * (channel x tile) as in the GEMM path. The output is split into blocks of CONV_WINOGRAD_TILES tiles.
+ *
+ * The transforms cost some precision, the float32 outputs of the Conv tests differ from the direct path by less than
+ * 1e-5 relative to the largest output.
+ */
+#define CONV_WINOGRAD_TILES 32
+
+// Feature maps of a batch are computed independently, Y is split by (batch, feature map) or (batch, group, tile)
+typedef struct _ConvTask {
+    connx_Tensor* Y;
+    connx_Tensor* X;
+    connx_Tensor* W;
+    connx_Tensor* B;
+    void* U; // of Winograd, or NULL
+    int32_t* x_iter;
+    int32_t* w_iter;
+    int32_t* dilations;
+    int32_t* pads;
+    int32_t* strides;
+    int32_t group;
+    ConvActivation activation;
+    float32_t alpha;
+    int ret;
+} ConvTask;
+
 TEMPLATE_START(FLOAT32, FLOAT64)
 #undef TEMPLATE_DTYPE
 #undef TEMPLATE_TYPE
 #define TEMPLATE_DTYPE FLOAT32
 #define TEMPLATE_TYPE float32_t
-#define connx_TEMPLATE_NAME_add connx_Float32_add
 static void _conv_TEMPLATE_NAME(connx_Tensor* Y, int32_t y_idx, connx_Tensor* X, int32_t* x_iter, 
                                 connx_Tensor* W, int32_t* w_iter, int32_t batch, int32_t x_channel, int32_t w_channel, 
                                 int32_t feature_map, int32_t* dilations) {
@@ -80,119 +141,812 @@ skip_TEMPLATE_NAME:
         y_idx++;
     }
 }
-TEMPLATE_END()
 
-int Conv(connx_Graph* graph, uint32_t output_count, uint32_t* outputs, uint32_t input_count, uint32_t* inputs, void** attributes) {
-	// inputs
-    connx_Tensor* X = connx_Graph_get(graph, inputs[0]);
-    connx_Tensor* W = connx_Graph_get(graph, inputs[1]);
-    connx_Tensor* B = NULL;
-    if(input_count >= 3) {
-        B = connx_Graph_get(graph, inputs[2]);
+// Epilogue of a feature map: bias and the activation are applied in one pass while Y is still in the cache
+static void _epilogue_TEMPLATE_NAME(int32_t count, TEMPLATE_TYPE* Y, TEMPLATE_TYPE bias, ConvActivation activation,
+                                    float32_t alpha) {
+    switch(activation) {
+        case CONV_ACTIVATION_RELU:
+            for(int32_t i = 0; i < count; i++) {
+                TEMPLATE_TYPE y = Y[i] + bias;
+                Y[i] = y < 0 ? 0 : y;
+            }
+            break;
+        case CONV_ACTIVATION_LEAKY_RELU:
+            for(int32_t i = 0; i < count; i++) {
+                TEMPLATE_TYPE y = Y[i] + bias;
+                Y[i] = y < 0 ? y * alpha : y;
+            }
+            break;
+        case CONV_ACTIVATION_SIGMOID:
+            for(int32_t i = 0; i < count; i++) {
+                Y[i] += bias;
+            }
+            connx_TEMPLATE_NAME_sigmoid(count, Y, Y);
+            break;
+        case CONV_ACTIVATION_MISH:
+            for(int32_t i = 0; i < count; i++) {
+                Y[i] += bias;
+            }
+            connx_TEMPLATE_NAME_mish(count, Y, Y);
+            break;
+        default:
+            if(bias != 0) {
+                for(int32_t i = 0; i < count; i++) {
+                    Y[i] += bias;
+                }
+            }
     }
+}
 
-	// attributes
-	char* auto_pad = attributes[0];
-	connx_AttributeInts* _dilations = attributes[1];
-	int32_t group = *(int32_t*)attributes[2];
-	connx_AttributeInts* _kernel_shape = attributes[3];
-	connx_AttributeInts* _pads = attributes[4];
-	connx_AttributeInts* _strides = attributes[5];
+static void _conv_task_TEMPLATE_NAME(void* context, int32_t start, int32_t end) {
+    ConvTask* task = context;
+    connx_Tensor* Y = task->Y;
+    connx_Tensor* X = task->X;
+    connx_Tensor* W = task->W;
 
-	// feature dimension
-	int32_t feature_dim = X->ndim - 2;
-	int32_t* feature_shape = X->shape + 2;
+    // Iterators keep their position, so each chunk needs its own copy
+    int32_t x_iter[connx_Iterator_size(connx_Iterator_ndim(task->x_iter))];
+    memcpy(x_iter, task->x_iter, sizeof(x_iter));
+
+    int32_t w_iter[connx_Iterator_size(connx_Iterator_ndim(task->w_iter))];
+    memcpy(w_iter, task->w_iter, sizeof(w_iter));
+
+    TEMPLATE_TYPE* Y_flatten = (TEMPLATE_TYPE*)Y->buffer;
+    TEMPLATE_TYPE* B_flatten = NULL;
+    if(task->B != NULL) {
+        B_flatten = (TEMPLATE_TYPE*)task->B->buffer;
+    }
 
-	// default attribute setting
-    int32_t dilations[feature_dim];
-    if(_dilations->count == 0) {
-        for(uint32_t i = 0; i < feature_dim; i++) {
-            dilations[i] = 1;
+    int32_t feature_map_count = W->shape[0];
+    int32_t channel_count = W->shape[1];
+    int32_t feature_group = feature_map_count / task->group;
+    int32_t y_unit = connx_Int32_product(Y->ndim - 2, Y->shape + 2);
+
+    for(int32_t i = start; i < end; i++) {
+        int32_t batch = i / feature_map_count;
+        int32_t feature_map = i % feature_map_count;
+        int32_t g = feature_map / feature_group;
+        int32_t y_idx = i * y_unit;
+
+        for(int32_t channel = 0; channel < channel_count; channel++) {
+            _conv_TEMPLATE_NAME(Y, y_idx, X, x_iter, W, w_iter, 
+                                batch, g * channel_count + channel, channel, 
+                                feature_map, task->dilations);
         }
-    } else {
-        memcpy(dilations, _dilations->array, sizeof(int32_t) * feature_dim);
+
+        _epilogue_TEMPLATE_NAME(y_unit, Y_flatten + y_idx, B_flatten != NULL ? B_flatten[feature_map] : 0,
+                                task->activation, task->alpha);
     }
+}
 
-    int32_t* kernel_shape = _kernel_shape->array;
-    int32_t kernel_dim = _kernel_shape->count;
+/**
+ * 2D depthwise Conv, each channel of X is a group of its own, Y is split by (batch, feature map). For each kernel
+ * column the range of the output columns whose input is not in the padding is calculated once, so the inner loop has
+ * no branch and runs along the rows of X and Y.
+ */
+static void _conv_depthwise_task_TEMPLATE_NAME(void* context, int32_t start, int32_t end) {
+    ConvTask* task = context;
+    connx_Tensor* Y = task->Y;
+    connx_Tensor* X = task->X;
+    connx_Tensor* W = task->W;
+
+    int32_t height = X->shape[2];
+    int32_t width = X->shape[3];
+    int32_t output_height = Y->shape[2];
+    int32_t output_width = Y->shape[3];
+    int32_t kernel_height = W->shape[2];
+    int32_t kernel_width = W->shape[3];
+    int32_t feature_map_count = W->shape[0];
+    int32_t multiplier = feature_map_count / X->shape[1];
+    int32_t stride_y = task->strides[0];
+    int32_t stride_x = task->strides[1];
+    int32_t dilation_y = task->dilations[0];
+    int32_t dilation_x = task->dilations[1];
 
-    int32_t pads[feature_dim * 2];
-    if(_pads->count == 0) {
-        for(uint32_t i = 0; i < feature_dim * 2; i++) {
-            pads[i] = 0;
+    TEMPLATE_TYPE* X_flatten = (TEMPLATE_TYPE*)X->buffer;
+    TEMPLATE_TYPE* W_flatten = (TEMPLATE_TYPE*)W->buffer;
+    TEMPLATE_TYPE* Y_flatten = (TEMPLATE_TYPE*)Y->buffer;
+    TEMPLATE_TYPE* B_flatten = task->B != NULL ? (TEMPLATE_TYPE*)task->B->buffer : NULL;
+
+    // Output columns [begins[kx], ends[kx]) read the input columns in the range
+    int32_t begins[kernel_width];
+    int32_t ends[kernel_width];
+    for(int32_t kx = 0; kx < kernel_width; kx++) {
+        int32_t offset = kx * dilation_x - task->pads[1];
+        begins[kx] = offset < 0 ? (-offset + stride_x - 1) / stride_x : 0;
+        ends[kx] = width - offset > 0 ? (width - offset + stride_x - 1) / stride_x : 0;
+        if(ends[kx] > output_width) {
+            ends[kx] = output_width;
         }
-    } else {
-        memcpy(pads, _pads->array, sizeof(int32_t) * feature_dim * 2);
     }
 
-    int32_t strides[feature_dim];
-    if(_strides->count == 0) {
-        for(uint32_t i = 0; i < feature_dim; i++) {
-            strides[i] = 1;
+    for(int32_t i = start; i < end; i++) {
+        int32_t batch = i / feature_map_count;
+        int32_t feature_map = i % feature_map_count;
+        TEMPLATE_TYPE* x = X_flatten + (batch * X->shape[1] + feature_map / multiplier) * height * width;
+        TEMPLATE_TYPE* w = W_flatten + feature_map * kernel_height * kernel_width;
+        TEMPLATE_TYPE* y = Y_flatten + i * output_height * output_width;
+
+        for(int32_t oy = 0; oy < output_height; oy++) {
+            TEMPLATE_TYPE* y_row = y + oy * output_width;
+            memset(y_row, 0, sizeof(TEMPLATE_TYPE) * output_width);
+
+            for(int32_t ky = 0; ky < kernel_height; ky++) {
+                int32_t iy = oy * stride_y + ky * dilation_y - task->pads[0];
+                if(iy < 0 || iy >= height) {
+                    continue;
+                }
+
+                TEMPLATE_TYPE* x_row = x + iy * width;
+                for(int32_t kx = 0; kx < kernel_width; kx++) {
+                    TEMPLATE_TYPE weight = w[ky * kernel_width + kx];
+                    TEMPLATE_TYPE* x_col = x_row + kx * dilation_x - task->pads[1];
+
+                    if(stride_x == 1) {
+                        for(int32_t ox = begins[kx]; ox < ends[kx]; ox++) {
+                            y_row[ox] += weight * x_col[ox];
+                        }
+                    } else {
+                        for(int32_t ox = begins[kx]; ox < ends[kx]; ox++) {
+                            y_row[ox] += weight * x_col[ox * stride_x];
+                        }
+                    }
+                }
+            }
         }
-    } else {
-        memcpy(strides, _strides->array, sizeof(int32_t) * feature_dim);
+
+        _epilogue_TEMPLATE_NAME(output_height * output_width, y, B_flatten != NULL ? B_flatten[feature_map] : 0,
+                                task->activation, task->alpha);
     }
+}
 
-    // output_spatial_shape
-    int32_t output_shape[feature_dim];
-    bzero(output_shape, sizeof(int32_t) * feature_dim);
+/**
+ * Columns [start, start + count) of the im2col matrix of the channels of a group which start at X. A row of the
+ * matrix is a (channel, kernel index) and a column is an output position, the element is the input under the kernel
+ * index at the position, or 0 in the padding.
+ */
+static void _im2col_TEMPLATE_NAME(TEMPLATE_TYPE* col, ConvTask* task, TEMPLATE_TYPE* X, int32_t start, int32_t count) {
+    int32_t feature_dim = task->X->ndim - 2;
+    int32_t* feature_shape = task->X->shape + 2;
+    int32_t* output_shape = task->Y->shape + 2;
+    int32_t* kernel_shape = task->W->shape + 2;
+    int32_t feature_size = connx_Int32_product(feature_dim, feature_shape);
+    int32_t kernel_size = connx_Int32_product(feature_dim, kernel_shape);
+    int32_t row_count = task->W->shape[1] * kernel_size;
+    int32_t last = feature_dim - 1;
+
+    int32_t x_units[feature_dim];
+    x_units[last] = 1;
+    for(int32_t i = last - 1; i >= 0; i--) {
+        x_units[i] = x_units[i + 1] * feature_shape[i + 1];
+    }
+
+    for(int32_t row = 0; row < row_count; row++) {
+        TEMPLATE_TYPE* x = X + row / kernel_size * feature_size;
+        TEMPLATE_TYPE* c = col + row * count;
+
+        // Input index of an output position is o_idx * strides + w_offsets
+        int32_t w_offsets[feature_dim];
+        for(int32_t i = last, rest = row % kernel_size; i >= 0; i--) {
+            w_offsets[i] = rest % kernel_shape[i] * task->dilations[i] - task->pads[i];
+            rest /= kernel_shape[i];
+        }
+
+        int32_t o_idx[feature_dim];
+        for(int32_t i = last, rest = start; i >= 0; i--) {
+            o_idx[i] = rest % output_shape[i];
+            rest /= output_shape[i];
+        }
+
+        // Runs along the last dimension share the other dimensions
+        for(int32_t n = 0; n < count;) {
+            int32_t run = output_shape[last] - o_idx[last];
+            if(run > count - n) {
+                run = count - n;
+            }
 
-    if(strcmp(auto_pad, "SAME_UPPER") == 0) {
-        for(int i = 0; i < feature_dim; i++) {
-            output_shape[i] = ceilf((float)feature_shape[i] / strides[i]);
-            int32_t pad = (output_shape[i] - 1) * strides[i] + ((kernel_shape[i] - 1) * dilations[i] + 1) - feature_shape[i];
-            pads[i] = pads[i + feature_dim] = pad / 2;
-            if(pad % 2 == 1) {
-                pads[i + feature_dim]++;
+            bool is_padding = false;
+            int32_t offset = 0;
+            for(int32_t i = 0; i < last; i++) {
+                int32_t x_idx = o_idx[i] * task->strides[i] + w_offsets[i];
+                if(x_idx < 0 || x_idx >= feature_shape[i]) {
+                    is_padding = true;
+                    break;
+                }
+
+                offset += x_idx * x_units[i];
+            }
+
+            int32_t stride = task->strides[last];
+            int32_t x_idx = o_idx[last] * stride + w_offsets[last];
+            for(int32_t i = 0; i < run; i++, x_idx += stride) {
+                c[n + i] = !is_padding && x_idx >= 0 && x_idx < feature_shape[last] ? x[offset + x_idx] : 0;
+            }
+
+            n += run;
+            o_idx[last] += run;
+            for(int32_t i = last; i > 0 && o_idx[i] == output_shape[i]; i--) {
+                o_idx[i] = 0;
+                o_idx[i - 1]++;
             }
         }
-    } else if(strcmp(auto_pad, "SAME_LOWER") == 0) {
-        for(int i = 0; i < feature_dim; i++) {
-            output_shape[i] = ceilf((float)feature_shape[i] / strides[i]);
-            int32_t pad = (output_shape[i] - 1) * strides[i] + ((kernel_shape[i] - 1) * dilations[i] + 1) - feature_shape[i];
-            pads[i] = pads[i + feature_dim] = pad / 2;
-            if(pad % 2 == 1) {
-                pads[i]++;
+    }
+}
+
+static void _conv_gemm_task_TEMPLATE_NAME(void* context, int32_t start, int32_t end) {
+    ConvTask* task = context;
+    connx_Tensor* Y = task->Y;
+    connx_Tensor* X = task->X;
+    connx_Tensor* W = task->W;
+
+    int32_t feature_dim = X->ndim - 2;
+    int32_t feature_size = connx_Int32_product(feature_dim, X->shape + 2);
+    int32_t feature_group = W->shape[0] / task->group;
+    int32_t channel_count = W->shape[1];
+    int32_t K = channel_count * connx_Int32_product(feature_dim, W->shape + 2);
+    int32_t N = connx_Int32_product(feature_dim, Y->shape + 2);
+    int32_t tile_count = (N + CONV_GEMM_TILE - 1) / CONV_GEMM_TILE;
+
+    TEMPLATE_TYPE* col = connx_alloc(sizeof(TEMPLATE_TYPE) * K * CONV_GEMM_TILE);
+    if(col == NULL) {
+        connx_error("Out of memory\n");
+        __atomic_store_n(&task->ret, CONNX_NOT_ENOUGH_MEMORY, __ATOMIC_RELAXED);
+        return;
+    }
+
+    TEMPLATE_TYPE* X_flatten = (TEMPLATE_TYPE*)X->buffer;
+    TEMPLATE_TYPE* W_flatten = (TEMPLATE_TYPE*)W->buffer;
+    TEMPLATE_TYPE* Y_flatten = (TEMPLATE_TYPE*)Y->buffer;
+    TEMPLATE_TYPE* B_flatten = task->B != NULL ? (TEMPLATE_TYPE*)task->B->buffer : NULL;
+
+    for(int32_t i = start; i < end; i++) {
+        int32_t tile = i % tile_count;
+        int32_t g = i / tile_count % task->group;
+        int32_t batch = i / tile_count / task->group;
+        int32_t n0 = tile * CONV_GEMM_TILE;
+        int32_t count = N - n0 < CONV_GEMM_TILE ? N - n0 : CONV_GEMM_TILE;
+        int32_t feature_map = g * feature_group;
+
+        _im2col_TEMPLATE_NAME(col, task, X_flatten + (batch * X->shape[1] + g * channel_count) * feature_size, n0,
+                              count);
+
+        TEMPLATE_TYPE* y = Y_flatten + (batch * W->shape[0] + feature_map) * N + n0;
+        if(connx_TEMPLATE_NAME_gemm(feature_group, count, K, W_flatten + feature_map * K, K, col, count, y, N) !=
+           CONNX_OK) {
+            connx_error("Out of memory\n");
+            __atomic_store_n(&task->ret, CONNX_NOT_ENOUGH_MEMORY, __ATOMIC_RELAXED);
+            break;
+        }
+
+        for(int32_t m = 0; m < feature_group; m++) {
+            _epilogue_TEMPLATE_NAME(count, y + m * N, B_flatten != NULL ? B_flatten[feature_map + m] : 0,
+                                    task->activation, task->alpha);
+        }
+    }
+
+    connx_free(col);
+}
+
+/**
+ * 1x1 Conv of stride 1 without padding is a GEMM of W (feature map x channel) and X (channel x position) of each
+ * group as they are, so the tiles of CONV_GEMM_TILE columns are read from X directly instead of the im2col matrix.
+ */
+static void _conv_pointwise_task_TEMPLATE_NAME(void* context, int32_t start, int32_t end) {
+    ConvTask* task = context;
+    connx_Tensor* Y = task->Y;
+    connx_Tensor* X = task->X;
+    connx_Tensor* W = task->W;
+
+    int32_t feature_group = W->shape[0] / task->group;
+    int32_t channel_count = W->shape[1];
+    int32_t N = connx_Int32_product(Y->ndim - 2, Y->shape + 2);
+    int32_t tile_count = (N + CONV_GEMM_TILE - 1) / CONV_GEMM_TILE;
+
+    TEMPLATE_TYPE* X_flatten = (TEMPLATE_TYPE*)X->buffer;
+    TEMPLATE_TYPE* W_flatten = (TEMPLATE_TYPE*)W->buffer;
+    TEMPLATE_TYPE* Y_flatten = (TEMPLATE_TYPE*)Y->buffer;
+    TEMPLATE_TYPE* B_flatten = task->B != NULL ? (TEMPLATE_TYPE*)task->B->buffer : NULL;
+
+    for(int32_t i = start; i < end; i++) {
+        int32_t tile = i % tile_count;
+        int32_t g = i / tile_count % task->group;
+        int32_t batch = i / tile_count / task->group;
+        int32_t n0 = tile * CONV_GEMM_TILE;
+        int32_t count = N - n0 < CONV_GEMM_TILE ? N - n0 : CONV_GEMM_TILE;
+        int32_t feature_map = g * feature_group;
+
+        TEMPLATE_TYPE* x = X_flatten + (batch * X->shape[1] + g * channel_count) * N + n0;
+        TEMPLATE_TYPE* y = Y_flatten + (batch * W->shape[0] + feature_map) * N + n0;
+        if(connx_TEMPLATE_NAME_gemm(feature_group, count, channel_count, W_flatten + feature_map * channel_count,
+                                    channel_count, x, N, y, N) != CONNX_OK) {
+            connx_error("Out of memory\n");
+            __atomic_store_n(&task->ret, CONNX_NOT_ENOUGH_MEMORY, __ATOMIC_RELAXED);
+            return;
+        }
+
+        for(int32_t m = 0; m < feature_group; m++) {
+            _epilogue_TEMPLATE_NAME(count, y + m * N, B_flatten != NULL ? B_flatten[feature_map + m] : 0,
+                                    task->activation, task->alpha);
+        }
+    }
+}
+
+// r = B^T d of the 6 elements of d, the elements are d_stride and r_stride apart
+static void _winograd_input_TEMPLATE_NAME(TEMPLATE_TYPE* d, int32_t d_stride, TEMPLATE_TYPE* r, int32_t r_stride) {
+    TEMPLATE_TYPE d0 = d[0], d1 = d[d_stride], d2 = d[d_stride * 2];
+    TEMPLATE_TYPE d3 = d[d_stride * 3], d4 = d[d_stride * 4], d5 = d[d_stride * 5];
+
+    r[0] = 4 * d0 - 5 * d2 + d4;
+    r[r_stride] = -4 * (d1 + d2) + d3 + d4;
+    r[r_stride * 2] = 4 * (d1 - d2) - d3 + d4;
+    r[r_stride * 3] = 2 * (d3 - d1) - d2 + d4;
+    r[r_stride * 4] = 2 * (d1 - d3) - d2 + d4;
+    r[r_stride * 5] = 4 * d1 - 5 * d3 + d5;
+}
+
+// r = G g of the 3 elements of g
+static void _winograd_filter_TEMPLATE_NAME(TEMPLATE_TYPE* g, int32_t g_stride, TEMPLATE_TYPE* r, int32_t r_stride) {
+    TEMPLATE_TYPE g0 = g[0], g1 = g[g_stride], g2 = g[g_stride * 2];
+
+    r[0] = g0 / 4;
+    r[r_stride] = -(g0 + g1 + g2) / 6;
+    r[r_stride * 2] = -(g0 - g1 + g2) / 6;
+    r[r_stride * 3] = g0 / 24 + g1 / 12 + g2 / 6;
+    r[r_stride * 4] = g0 / 24 - g1 / 12 + g2 / 6;
+    r[r_stride * 5] = g2;
+}
+
+// r = A^T m of the 6 elements of m
+static void _winograd_output_TEMPLATE_NAME(TEMPLATE_TYPE* m, int32_t m_stride, TEMPLATE_TYPE* r, int32_t r_stride) {
+    TEMPLATE_TYPE m0 = m[0], m1 = m[m_stride], m2 = m[m_stride * 2];
+    TEMPLATE_TYPE m3 = m[m_stride * 3], m4 = m[m_stride * 4], m5 = m[m_stride * 5];
+
+    r[0] = m0 + m1 + m2 + m3 + m4;
+    r[r_stride] = m1 - m2 + 2 * (m3 - m4);
+    r[r_stride * 2] = m1 + m2 + 4 * (m3 + m4);
+    r[r_stride * 3] = m1 - m2 + 8 * (m3 - m4) + m5;
+}
+
+// U = G g G^T of each 3x3 filter of W, U is [group][36][feature map of the group][channel]
+static void _winograd_transform_TEMPLATE_NAME(connx_Tensor* W, int32_t group, TEMPLATE_TYPE* U) {
+    TEMPLATE_TYPE* W_flatten = (TEMPLATE_TYPE*)W->buffer;
+    int32_t feature_map_count = W->shape[0];
+    int32_t channel_count = W->shape[1];
+    int32_t feature_group = feature_map_count / group;
+
+    for(int32_t feature_map = 0; feature_map < feature_map_count; feature_map++) {
+        int32_t g = feature_map / feature_group;
+        int32_t m = feature_map % feature_group;
+
+        for(int32_t channel = 0; channel < channel_count; channel++) {
+            TEMPLATE_TYPE* filter = W_flatten + (feature_map * channel_count + channel) * 9;
+            TEMPLATE_TYPE tmp[6 * 3];
+            TEMPLATE_TYPE u[6 * 6];
+
+            for(int32_t i = 0; i < 3; i++) {
+                _winograd_filter_TEMPLATE_NAME(filter + i, 3, tmp + i, 3);
+            }
+
+            for(int32_t i = 0; i < 6; i++) {
+                _winograd_filter_TEMPLATE_NAME(tmp + i * 3, 1, u + i * 6, 1);
+            }
+
+            for(int32_t k = 0; k < 36; k++) {
+                U[((g * 36 + k) * feature_group + m) * channel_count + channel] = u[k];
             }
         }
-    } else {
-        for(int i = 0; i < feature_dim; i++) {
-            output_shape[i] = (feature_shape[i] + pads[i] + pads[i + feature_dim] - ((kernel_shape[i] - 1) * dilations[i] + 1)) / strides[i] + 1;
+    }
+}
+
+static void _conv_winograd_task_TEMPLATE_NAME(void* context, int32_t start, int32_t end) {
+    ConvTask* task = context;
+    connx_Tensor* Y = task->Y;
+    connx_Tensor* X = task->X;
+    connx_Tensor* W = task->W;
+
+    int32_t height = X->shape[2];
+    int32_t width = X->shape[3];
+    int32_t output_height = Y->shape[2];
+    int32_t output_width = Y->shape[3];
+    int32_t feature_group = W->shape[0] / task->group;
+    int32_t channel_count = W->shape[1];
+    int32_t column_count = (output_width + 3) / 4;
+    int32_t tile_count = (output_height + 3) / 4 * column_count;
+    int32_t block_count = (tile_count + CONV_WINOGRAD_TILES - 1) / CONV_WINOGRAD_TILES;
+
+    // V is [36][channel][tile] and M is [36][feature map of the group][tile]
+    TEMPLATE_TYPE* V = connx_alloc(sizeof(TEMPLATE_TYPE) * 36 * (channel_count + feature_group) * CONV_WINOGRAD_TILES);
+    if(V == NULL) {
+        connx_error("Out of memory\n");
+        __atomic_store_n(&task->ret, CONNX_NOT_ENOUGH_MEMORY, __ATOMIC_RELAXED);
+        return;
+    }
+    TEMPLATE_TYPE* M = V + 36 * channel_count * CONV_WINOGRAD_TILES;
+
+    TEMPLATE_TYPE* X_flatten = (TEMPLATE_TYPE*)X->buffer;
+    TEMPLATE_TYPE* Y_flatten = (TEMPLATE_TYPE*)Y->buffer;
+    TEMPLATE_TYPE* U = task->U;
+    TEMPLATE_TYPE* B_flatten = task->B != NULL ? (TEMPLATE_TYPE*)task->B->buffer : NULL;
+
+    for(int32_t i = start; i < end; i++) {
+        int32_t block = i % block_count;
+        int32_t g = i / block_count % task->group;
+        int32_t batch = i / block_count / task->group;
+        int32_t tile = block * CONV_WINOGRAD_TILES;
+        int32_t count = tile_count - tile < CONV_WINOGRAD_TILES ? tile_count - tile : CONV_WINOGRAD_TILES;
+
+        // V = B^T d B of the 6x6 input tile of each output tile, 0 in the padding
+        for(int32_t channel = 0; channel < channel_count; channel++) {
+            TEMPLATE_TYPE* x = X_flatten + (batch * X->shape[1] + g * channel_count + channel) * height * width;
+
+            for(int32_t t = 0; t < count; t++) {
+                int32_t y0 = (tile + t) / column_count * 4 - task->pads[0];
+                int32_t x0 = (tile + t) % column_count * 4 - task->pads[1];
+                TEMPLATE_TYPE d[6 * 6];
+                TEMPLATE_TYPE tmp[6 * 6];
+
+                for(int32_t r = 0; r < 6; r++) {
+                    for(int32_t c = 0; c < 6; c++) {
+                        int32_t y_idx = y0 + r;
+                        int32_t x_idx = x0 + c;
+                        d[r * 6 + c] = y_idx >= 0 && y_idx < height && x_idx >= 0 && x_idx < width
+                                           ? x[y_idx * width + x_idx]
+                                           : 0;
+                    }
+                }
+
+                for(int32_t c = 0; c < 6; c++) {
+                    _winograd_input_TEMPLATE_NAME(d + c, 6, tmp + c, 6);
+                }
+
+                TEMPLATE_TYPE* v = V + channel * count + t;
+                for(int32_t r = 0; r < 6; r++) {
+                    _winograd_input_TEMPLATE_NAME(tmp + r * 6, 1, v + r * 6 * channel_count * count,
+                                                  channel_count * count);
+                }
+            }
+        }
+
+        for(int32_t k = 0; k < 36; k++) {
+            if(connx_TEMPLATE_NAME_gemm(feature_group, count, channel_count,
+                                        U + (g * 36 + k) * feature_group * channel_count, channel_count,
+                                        V + k * channel_count * count, count, M + k * feature_group * count,
+                                        count) != CONNX_OK) {
+                connx_error("Out of memory\n");
+                __atomic_store_n(&task->ret, CONNX_NOT_ENOUGH_MEMORY, __ATOMIC_RELAXED);
+                connx_free(V);
+                return;
+            }
+        }
+
+        // Y = A^T M A of each tile, the tiles on the edges are cut
+        for(int32_t m = 0; m < feature_group; m++) {
+            int32_t feature_map = g * feature_group + m;
+            TEMPLATE_TYPE* y = Y_flatten + (batch * W->shape[0] + feature_map) * output_height * output_width;
+            TEMPLATE_TYPE bias = B_flatten != NULL ? B_flatten[feature_map] : 0;
+
+            for(int32_t t = 0; t < count; t++) {
+                int32_t y0 = (tile + t) / column_count * 4;
+                int32_t x0 = (tile + t) % column_count * 4;
+                TEMPLATE_TYPE tmp[4 * 6];
+                TEMPLATE_TYPE o[4 * 4];
+
+                TEMPLATE_TYPE* mt = M + m * count + t;
+                for(int32_t c = 0; c < 6; c++) {
+                    _winograd_output_TEMPLATE_NAME(mt + c * feature_group * count, 6 * feature_group * count,
+                                                   tmp + c, 6);
+                }
+
+                for(int32_t r = 0; r < 4; r++) {
+                    _winograd_output_TEMPLATE_NAME(tmp + r * 6, 1, o + r * 4, 1);
+                }
+
+                _epilogue_TEMPLATE_NAME(16, o, bias, task->activation, task->alpha);
+
+                for(int32_t r = 0; r < 4 && y0 + r < output_height; r++) {
+                    for(int32_t c = 0; c < 4 && x0 + c < output_width; c++) {
+                        y[(y0 + r) * output_width + x0 + c] = o[r * 4 + c];
+                    }
+                }
+            }
+        }
+    }
+
+    connx_free(V);
+}
+TEMPLATE_END()
+
+// Output spatial shape and pads of the input spatial shape
+static void get_output_shape(ConvPlan* plan, int32_t* feature_shape, int32_t* output_shape, int32_t* pads) {
+    int32_t feature_dim = plan->feature_dim;
+    int32_t* dilations = plan->dilations;
+    int32_t* kernel_shape = plan->kernel_shape;
+    int32_t* strides = plan->strides;
+
+    memcpy(pads, plan->pads, sizeof(int32_t) * feature_dim * 2);
+
+    switch(plan->auto_pad) {
+        case CONNX_AUTO_PAD_SAME_UPPER:
+            for(int i = 0; i < feature_dim; i++) {
+                output_shape[i] = ceilf((float)feature_shape[i] / strides[i]);
+                int32_t pad = (output_shape[i] - 1) * strides[i] + ((kernel_shape[i] - 1) * dilations[i] + 1) - feature_shape[i];
+                pads[i] = pads[i + feature_dim] = pad / 2;
+                if(pad % 2 == 1) {
+                    pads[i + feature_dim]++;
+                }
+            }
+            break;
+        case CONNX_AUTO_PAD_SAME_LOWER:
+            for(int i = 0; i < feature_dim; i++) {
+                output_shape[i] = ceilf((float)feature_shape[i] / strides[i]);
+                int32_t pad = (output_shape[i] - 1) * strides[i] + ((kernel_shape[i] - 1) * dilations[i] + 1) - feature_shape[i];
+                pads[i] = pads[i + feature_dim] = pad / 2;
+                if(pad % 2 == 1) {
+                    pads[i]++;
+                }
+            }
+            break;
+        default:
+            for(int i = 0; i < feature_dim; i++) {
+                output_shape[i] = (feature_shape[i] + pads[i] + pads[i + feature_dim] - ((kernel_shape[i] - 1) * dilations[i] + 1)) / strides[i] + 1;
+            }
+    }
+}
+
+// Attribute of ints which is value for all the count elements, or not given
+static bool is_all(connx_AttributeInts* ints, uint32_t count, int32_t value) {
+    if(ints->count != 0 && ints->count != count) {
+        return false;
+    }
+
+    for(uint32_t i = 0; i < ints->count; i++) {
+        if(ints->array[i] != value) {
+            return false;
         }
     }
 
+    return true;
+}
+
+// W of the Conv if it is run by Winograd, or NULL
+static connx_Tensor* get_winograd_W(connx_Graph* graph, connx_Node* node) {
+    connx_AttributeInts* dilations = node->attributes[1];
+    int32_t group = *(int32_t*)node->attributes[2];
+    connx_AttributeInts* kernel_shape = node->attributes[3];
+    connx_AttributeInts* strides = node->attributes[5];
+
+    if(kernel_shape->count != 2 || !is_all(kernel_shape, 2, 3) || !is_all(dilations, 2, 1) ||
+       !is_all(strides, 2, 1) || node->input_count < 2) {
+        return NULL;
+    }
+
+    connx_Tensor* W = connx_Graph_get_constant(graph, node->inputs[1]);
+    if(W == NULL || (W->dtype != CONNX_FLOAT32 && W->dtype != CONNX_FLOAT64) || W->ndim != 4 || W->shape[2] != 3 ||
+       W->shape[3] != 3 || group <= 0 || W->shape[0] % group != 0 ||
+       W->shape[0] / group < CONV_GEMM_MIN_FEATURE_MAPS) {
+        return NULL;
+    }
+
+    return W;
+}
+
+int Conv_prepare(connx_Graph* graph, connx_Node* node) {
+    char* auto_pad = node->attributes[0];
+    connx_AttributeInts* _dilations = node->attributes[1];
+    int32_t group = *(int32_t*)node->attributes[2];
+    connx_AttributeInts* _kernel_shape = node->attributes[3];
+    connx_AttributeInts* _pads = node->attributes[4];
+    connx_AttributeInts* _strides = node->attributes[5];
+
+    if(_kernel_shape->count == 0) {
+        connx_error("Conv: kernel_shape is required.\n");
+        return CONNX_NOT_SUPPORTED_ATTRIBUTE;
+    }
+
+    int32_t feature_dim = _kernel_shape->count;
+
+    // dilations, kernel_shape, pads, strides, w_iter and U which is aligned for float64
+    uint32_t array_size = sizeof(int32_t) * (feature_dim * 5 + connx_Iterator_size(feature_dim));
+    array_size = (array_size + sizeof(float64_t) - 1) / sizeof(float64_t) * sizeof(float64_t);
+
+    connx_Tensor* W = get_winograd_W(graph, node);
+    uint32_t U_size = W != NULL ? connx_DataType_size(W->dtype) * W->shape[0] * W->shape[1] * 36 : 0;
+
+    ConvPlan* plan = connx_alloc(sizeof(ConvPlan) + array_size + U_size);
+    if(plan == NULL) {
+        connx_error("Out of memory\n");
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+    node->plan = plan;
+
+    plan->group = group;
+    plan->feature_dim = feature_dim;
+    plan->dilations = plan->array;
+    plan->kernel_shape = plan->dilations + feature_dim;
+    plan->pads = plan->kernel_shape + feature_dim;
+    plan->strides = plan->pads + feature_dim * 2;
+    plan->w_iter = plan->strides + feature_dim;
+    plan->winograd_W = W;
+    plan->U = W != NULL ? (uint8_t*)plan->array + array_size : NULL;
+
+    int ret = connx_AutoPad_parse(auto_pad, &plan->auto_pad);
+    if(ret == CONNX_OK) {
+        ret = connx_AttributeInts_get(_dilations, feature_dim, plan->dilations, 1);
+    }
+    if(ret == CONNX_OK) {
+        ret = connx_AttributeInts_get(_kernel_shape, feature_dim, plan->kernel_shape, 0);
+    }
+    if(ret == CONNX_OK) {
+        ret = connx_AttributeInts_get(_pads, feature_dim * 2, plan->pads, 0);
+    }
+    if(ret == CONNX_OK) {
+        ret = connx_AttributeInts_get(_strides, feature_dim, plan->strides, 1);
+    }
+    if(ret != CONNX_OK) {
+        return ret;
+    }
+
+    int32_t starts[feature_dim];
+    int32_t steps[feature_dim];
+    for(int32_t i = 0; i < feature_dim; i++) {
+        starts[i] = 0;
+        steps[i] = 1;
+    }
+
+    connx_Iterator_init(plan->w_iter, feature_dim, starts, plan->kernel_shape, steps);
+
+    if(W != NULL) {
+        switch(W->dtype) {
+            TEMPLATE_START(FLOAT32, FLOAT64)
+#undef TEMPLATE_DTYPE
+#undef TEMPLATE_TYPE
+#define TEMPLATE_DTYPE FLOAT32
+#define TEMPLATE_TYPE float32_t
+            case TEMPLATE_DTYPE:
+                _winograd_transform_TEMPLATE_NAME(W, plan->group, plan->U);
+                break;
+                TEMPLATE_END()
+            default:
+                break;
+        }
+    }
+
+    return CONNX_OK;
+}
+
+int Conv_infer(connx_Graph* graph, connx_Node* node) {
+    ConvPlan* plan = node->plan;
+    connx_ValueInfo* X = connx_Graph_get_value_info(graph, node->inputs[0]);
+    connx_ValueInfo* W = connx_Graph_get_value_info(graph, node->inputs[1]);
+
+    if(X->ndim != 2 + plan->feature_dim) {
+        connx_error("Conv: X must be %d dimensional.\n", 2 + plan->feature_dim);
+        return CONNX_TENSOR_SHAPE_NOT_MATCHING;
+    }
+
+    int32_t Y_shape[X->ndim];
+    int32_t pads[plan->feature_dim * 2];
+    Y_shape[0] = X->shape[0];
+    Y_shape[1] = W->shape[0];
+    get_output_shape(plan, X->shape + 2, Y_shape + 2, pads);
+
+    return connx_Graph_set_value_info(graph, node->outputs[0], X->dtype, X->ndim, Y_shape);
+}
+
+// Activation of the epilogue which runs next, or CONV_ACTIVATION_NONE
+static ConvActivation get_activation(connx_Node* next) {
+    if(next->input_count != 1) {
+        return CONV_ACTIVATION_NONE;
+    } else if(strcmp(next->op_type, "Relu") == 0) {
+        return CONV_ACTIVATION_RELU;
+    } else if(strcmp(next->op_type, "LeakyRelu") == 0) {
+        return CONV_ACTIVATION_LEAKY_RELU;
+    } else if(strcmp(next->op_type, "Sigmoid") == 0) {
+        return CONV_ACTIVATION_SIGMOID;
+    } else if(strcmp(next->op_type, "Mish") == 0) {
+        return CONV_ACTIVATION_MISH;
+    } else {
+        return CONV_ACTIVATION_NONE;
+    }
+}
+
+// Relu, LeakyRelu, Sigmoid or Mish after the Conv is applied by the epilogue
+bool Conv_can_fuse(__attribute__((unused)) connx_Graph* graph, connx_Node* node, connx_Node* next) {
+    ConvPlan* plan = node->plan;
+
+    return plan->activation == CONV_ACTIVATION_NONE && get_activation(next) != CONV_ACTIVATION_NONE;
+}
+
+int Conv_fuse(__attribute__((unused)) connx_Graph* graph, connx_Node* node, connx_Node* next) {
+    ConvPlan* plan = node->plan;
+
+    plan->activation = get_activation(next);
+    if(plan->activation == CONV_ACTIVATION_LEAKY_RELU) {
+        plan->alpha = *(float32_t*)next->attributes[0];
+    }
+
+    return CONNX_OK;
+}
+
+int Conv(connx_Context* context, uint32_t output_count, uint32_t* outputs, uint32_t input_count, uint32_t* inputs,
+         __attribute__((unused)) void** attributes, void* _plan) {
+	// inputs
+    connx_Tensor* X = connx_Context_get(context, inputs[0]);
+    connx_Tensor* W = connx_Context_get(context, inputs[1]);
+    connx_Tensor* B = NULL;
+    if(input_count >= 3) {
+        B = connx_Context_get(context, inputs[2]);
+    }
+
+	// attributes
+    ConvPlan* plan = _plan;
+    int32_t* dilations = plan->dilations;
+    int32_t* strides = plan->strides;
+
+	// feature dimension
+	int32_t feature_dim = plan->feature_dim;
+	int32_t* feature_shape = X->shape + 2;
+
+    if(X->ndim != 2 + feature_dim) {
+        connx_error("Conv: X must be %d dimensional.\n", 2 + feature_dim);
+        return CONNX_TENSOR_SHAPE_NOT_MATCHING;
+    }
+
+    // output_spatial_shape
+    int32_t output_shape[feature_dim];
+    int32_t pads[feature_dim * 2];
+    get_output_shape(plan, feature_shape, output_shape, pads);
+
     // Conv
     int32_t Y_shape[2 + feature_dim];
     Y_shape[0] = X->shape[0];
     Y_shape[1] = W->shape[0];
     memcpy(Y_shape + 2, output_shape, sizeof(int32_t) * feature_dim);
 
-    connx_Tensor* Y = connx_Tensor_alloc(X->dtype, 2 + feature_dim, Y_shape);
+    connx_Tensor* Y = connx_Context_alloc(context, outputs[0], X->dtype, 2 + feature_dim, Y_shape);
+    if(Y == NULL) {
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
 
     // init x_iter
     int32_t starts[feature_dim];
     int32_t stops[feature_dim];
-    int32_t steps[feature_dim];
 
     for(int32_t i = 0; i < feature_dim; i++) {
         starts[i] = -pads[i];
         stops[i] = -pads[i] + output_shape[i] * strides[i];
-        steps[i] = strides[i];
     }
 
     int32_t x_iter[connx_Iterator_size(feature_dim)];
-    connx_Iterator_init(x_iter, feature_dim, starts, stops, steps);
+    connx_Iterator_init(x_iter, feature_dim, starts, stops, strides);
 
-    // init w_iter
-    for(int32_t i = 0; i < kernel_dim; i++) {
-        starts[i] = 0;
-        stops[i] = kernel_shape[i];
-        steps[i] = 1;
+    // U is transformed from the initializer which the Conv is prepared with
+    void* U = plan->winograd_W == W && X->dtype == W->dtype ? plan->U : NULL;
+
+    ConvTask task = {Y, X, W, B, U, x_iter, plan->w_iter, dilations, pads, strides, plan->group, plan->activation,
+                     plan->alpha, CONNX_OK};
+
+    // Each input channel is a group of its own
+    bool is_depthwise = feature_dim == 2 && plan->group == X->shape[1] && W->shape[1] == 1;
+
+    // X is the matrix of the GEMM as it is
+    bool is_pointwise = true;
+    for(int32_t i = 0; i < feature_dim; i++) {
+        if(W->shape[2 + i] != 1 || strides[i] != 1 || pads[i] != 0 || pads[i + feature_dim] != 0) {
+            is_pointwise = false;
+        }
     }
 
-    int32_t w_iter[connx_Iterator_size(kernel_dim)];
-    connx_Iterator_init(w_iter, kernel_dim, starts, stops, steps);
+    // The im2col matrix is shared by the feature maps of a group
+    bool is_gemm = W->shape[0] / plan->group >= CONV_GEMM_MIN_FEATURE_MAPS;
+    int32_t tile_count = (connx_Int32_product(feature_dim, output_shape) + CONV_GEMM_TILE - 1) / CONV_GEMM_TILE;
+
+    // Winograd is split by (batch, group, block of tiles)
+    int32_t winograd_count = U != NULL ? X->shape[0] * plan->group *
+                                             (((output_shape[0] + 3) / 4 * ((output_shape[1] + 3) / 4) +
+                                               CONV_WINOGRAD_TILES - 1) / CONV_WINOGRAD_TILES)
+                                       : 0;
 
     switch(X->dtype) {
         TEMPLATE_START(FLOAT32, FLOAT64)
@@ -200,51 +954,34 @@ int Conv(connx_Graph* graph, uint32_t output_count, uint32_t* outputs, uint32_t
 #undef TEMPLATE_TYPE
 #define TEMPLATE_DTYPE FLOAT32
 #define TEMPLATE_TYPE float32_t
-#define connx_TEMPLATE_NAME_add connx_Float32_add
-#define connx_TEMPLATE_NAME_broadcast connx_Float32_broadcast
-        case TEMPLATE_DTYPE: {
-            TEMPLATE_TYPE* Y_flatten = (TEMPLATE_TYPE*)Y->buffer;
-            TEMPLATE_TYPE* B_flatten = NULL;
-            if(B != NULL) {
-                B_flatten = (TEMPLATE_TYPE*)B->buffer;
-            }
-
-            int32_t batch_count = X->shape[0];
-            int32_t channel_count = W->shape[1];
-            int32_t feature_group = W->shape[0] / group;
-
-            int32_t y_idx = 0;
-            int32_t y_unit = connx_Int32_product(feature_dim, output_shape);
-
-            for(int32_t batch = 0; batch < batch_count; batch++) {
-                for(int32_t g = 0; g < group; g++) {
-                    for(int32_t feature_map = g * feature_group; feature_map < (g + 1) * feature_group; feature_map++) {
-                        for(int32_t channel = 0; channel < channel_count; channel++) {
-                            _conv_TEMPLATE_NAME(Y, y_idx, X, x_iter, W, w_iter, 
-                                                batch, g * channel_count + channel, channel, 
-                                                feature_map, dilations);
-                        }
-
-                        if(B_flatten != NULL) {
-                            TEMPLATE_TYPE B_array[y_unit];
-                            connx_TEMPLATE_NAME_broadcast(y_unit, B_array, 1, B_flatten + feature_map);
-                            connx_TEMPLATE_NAME_add(y_unit, Y_flatten + y_idx, Y_flatten + y_idx, B_array);
-                        }
-
-                        y_idx += y_unit;
-                    }
-                }
+        case TEMPLATE_DTYPE:
+            if(is_depthwise) {
+                connx_parallel_for(X->shape[0] * W->shape[0], 1, _conv_depthwise_task_TEMPLATE_NAME, &task);
+            } else if(is_pointwise) {
+                connx_parallel_for(X->shape[0] * plan->group * tile_count, 1, _conv_pointwise_task_TEMPLATE_NAME,
+                                   &task);
+            } else if(U != NULL) {
+                connx_parallel_for(winograd_count, 1, _conv_winograd_task_TEMPLATE_NAME, &task);
+            } else if(is_gemm) {
+                connx_parallel_for(X->shape[0] * plan->group * tile_count, 1, _conv_gemm_task_TEMPLATE_NAME, &task);
+            } else {
+                connx_parallel_for(X->shape[0] * W->shape[0], 1, _conv_task_TEMPLATE_NAME, &task);
             }
-
             break;
-        }
             TEMPLATE_END()
         default:
             connx_error("Conv: Datatype %d is not supported yet.\n", X->dtype);
+            connx_Tensor_unref(Y);
             return CONNX_NOT_SUPPORTED_DATATYPE;
     }
 
-    connx_Graph_set(graph, outputs[0], Y);
+    // Scratch of a task is not allocated
+    if(task.ret != CONNX_OK) {
+        connx_Tensor_unref(Y);
+        return task.ret;
+    }
+
+    connx_Context_set(context, outputs[0], Y);
 
     return CONNX_OK;
 }
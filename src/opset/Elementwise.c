@@ -0,0 +1,320 @@
+#include <string.h>
+#include <connx/accel.h>
+#include <connx/connx.h>
+#include <connx/hal.h>
+
+/**
+ * Elementwise is not an ONNX operator, it runs a group of elementwise nodes which connx_Graph_optimize fuses into one
+ * node. The output is split into blocks of BLOCK_SIZE elements and all the instructions run on a block before the
+ * next one, so each intermediate value is a block in the cache instead of a tensor in the memory.
+ */
+#define BLOCK_SIZE 256
+
+// How the elements of an input are loaded to its register
+typedef enum _ElementwiseAccess {
+    ELEMENTWISE_DIRECT,    // the same shape as the output, the register points the input
+    ELEMENTWISE_SCALAR,    // one element, the register is filled once
+    ELEMENTWISE_BROADCAST, // the elements are gathered for each block
+} ElementwiseAccess;
+
+typedef struct _ElementwiseTask {
+    connx_ElementwisePlan* plan;
+    connx_DataType dtype;
+    uint32_t input_count;
+    connx_Tensor** inputs;
+    ElementwiseAccess* accesses;
+    int32_t ndim;
+    int32_t* shape;   // of the output
+    int32_t* strides; // of each input in the output, 0 for the broadcast dimensions
+    void* output;
+    int ret;
+} ElementwiseTask;
+
+// Gather the elements [start, start + count) of the output from a broadcast input
+static void gather(ElementwiseTask* task, uint32_t input, int32_t start, int32_t count, void* reg) {
+    int32_t ndim = task->ndim;
+    int32_t* shape = task->shape;
+    int32_t* strides = task->strides + input * ndim;
+    uint32_t size = connx_DataType_size(task->dtype);
+    uint8_t* src = task->inputs[input]->buffer;
+    uint8_t* dst = reg;
+
+    int32_t index[ndim];
+    int32_t offset = 0;
+    for(int32_t i = ndim - 1, rest = start; i >= 0; i--) {
+        index[i] = rest % shape[i];
+        rest /= shape[i];
+        offset += index[i] * strides[i];
+    }
+
+    for(int32_t i = 0; i < count; i++) {
+        memcpy(dst + i * size, src + offset * size, size);
+
+        for(int32_t j = ndim - 1; j >= 0; j--) {
+            offset += strides[j];
+            if(++index[j] < shape[j]) {
+                break;
+            }
+
+            offset -= strides[j] * shape[j];
+            index[j] = 0;
+        }
+    }
+}
+
+// Instructions of the floating point types only
+TEMPLATE_START(FLOAT32, FLOAT64)
+#undef TEMPLATE_DTYPE
+#undef TEMPLATE_TYPE
+#define TEMPLATE_DTYPE FLOAT32
+#define TEMPLATE_TYPE float32_t
+static void _math_TEMPLATE_NAME(connx_ElementwiseInstruction* instruction, int32_t count, void* _y, void* _a) {
+    TEMPLATE_TYPE* y = _y;
+    TEMPLATE_TYPE* a = _a;
+
+    switch(instruction->op) {
+        case CONNX_ELEMENTWISE_LEAKY_RELU:
+            for(int32_t i = 0; i < count; i++) {
+                y[i] = a[i] < 0 ? a[i] * instruction->alpha : a[i];
+            }
+            break;
+        case CONNX_ELEMENTWISE_SIGMOID:
+            connx_TEMPLATE_NAME_sigmoid(count, y, a);
+            break;
+        case CONNX_ELEMENTWISE_ASIN:
+            connx_TEMPLATE_NAME_asin(count, y, a);
+            break;
+        case CONNX_ELEMENTWISE_EXP:
+            connx_TEMPLATE_NAME_exp(count, y, a);
+            break;
+        case CONNX_ELEMENTWISE_LOG:
+            connx_TEMPLATE_NAME_log(count, y, a);
+            break;
+        case CONNX_ELEMENTWISE_TANH:
+            connx_TEMPLATE_NAME_tanh(count, y, a);
+            break;
+        case CONNX_ELEMENTWISE_MISH:
+            connx_TEMPLATE_NAME_mish(count, y, a);
+            break;
+        default:
+            break;
+    }
+}
+TEMPLATE_END()
+
+static void math(connx_DataType dtype, connx_ElementwiseInstruction* instruction, int32_t count, void* y, void* a) {
+    switch(dtype) {
+        case CONNX_FLOAT32:
+            _math_Float32(instruction, count, y, a);
+            break;
+        case CONNX_FLOAT64:
+            _math_Float64(instruction, count, y, a);
+            break;
+        default:
+            break;
+    }
+}
+
+TEMPLATE_START(UINT8, UINT16, UINT32, UINT64, INT8, INT16, INT32, INT64, FLOAT32, FLOAT64)
+#undef TEMPLATE_DTYPE
+#undef TEMPLATE_TYPE
+#define TEMPLATE_DTYPE FLOAT32
+#define TEMPLATE_TYPE float32_t
+static void _run_TEMPLATE_NAME(void* context, int32_t start, int32_t end) {
+    ElementwiseTask* task = context;
+    connx_ElementwisePlan* plan = task->plan;
+    uint32_t input_count = task->input_count;
+    uint32_t register_count = input_count + plan->count;
+
+    TEMPLATE_TYPE* scratch = connx_alloc(sizeof(TEMPLATE_TYPE) * BLOCK_SIZE * register_count);
+    if(scratch == NULL) {
+        connx_error("Out of memory\n");
+        __atomic_store_n(&task->ret, CONNX_NOT_ENOUGH_MEMORY, __ATOMIC_RELAXED);
+        return;
+    }
+
+    TEMPLATE_TYPE* registers[register_count];
+    for(uint32_t i = 0; i < register_count; i++) {
+        registers[i] = scratch + i * BLOCK_SIZE;
+    }
+
+    // Scalars are the same for all the blocks
+    for(uint32_t i = 0; i < input_count; i++) {
+        if(task->accesses[i] == ELEMENTWISE_SCALAR) {
+            TEMPLATE_TYPE value = *(TEMPLATE_TYPE*)task->inputs[i]->buffer;
+            for(int32_t j = 0; j < BLOCK_SIZE; j++) {
+                registers[i][j] = value;
+            }
+        }
+    }
+
+    for(int32_t block = start; block < end; block += BLOCK_SIZE) {
+        int32_t count = end - block < BLOCK_SIZE ? end - block : BLOCK_SIZE;
+
+        for(uint32_t i = 0; i < input_count; i++) {
+            if(task->accesses[i] == ELEMENTWISE_DIRECT) {
+                registers[i] = (TEMPLATE_TYPE*)task->inputs[i]->buffer + block;
+            } else if(task->accesses[i] == ELEMENTWISE_BROADCAST) {
+                gather(task, i, block, count, registers[i]);
+            }
+        }
+
+        // The last instruction writes the output
+        registers[register_count - 1] = (TEMPLATE_TYPE*)task->output + block;
+
+        for(uint32_t i = 0; i < plan->count; i++) {
+            connx_ElementwiseInstruction* instruction = &plan->instructions[i];
+            TEMPLATE_TYPE* y = registers[input_count + i];
+            TEMPLATE_TYPE* a = registers[instruction->a];
+            TEMPLATE_TYPE* b = registers[instruction->b];
+
+            switch(instruction->op) {
+                case CONNX_ELEMENTWISE_ADD:
+                    for(int32_t j = 0; j < count; j++) {
+                        y[j] = a[j] + b[j];
+                    }
+                    break;
+                case CONNX_ELEMENTWISE_SUB:
+                    for(int32_t j = 0; j < count; j++) {
+                        y[j] = a[j] - b[j];
+                    }
+                    break;
+                case CONNX_ELEMENTWISE_MUL:
+                    for(int32_t j = 0; j < count; j++) {
+                        y[j] = a[j] * b[j];
+                    }
+                    break;
+                case CONNX_ELEMENTWISE_RELU:
+                    for(int32_t j = 0; j < count; j++) {
+                        y[j] = a[j] < 0 ? 0 : a[j];
+                    }
+                    break;
+                default:
+                    math(TEMPLATE_DTYPE, instruction, count, y, a);
+            }
+        }
+    }
+
+    connx_free(scratch);
+}
+TEMPLATE_END()
+
+int Elementwise_infer(connx_Graph* graph, connx_Node* node) {
+    return connx_infer_elementwise(graph, node);
+}
+
+int Elementwise(connx_Context* context, uint32_t output_count, uint32_t* outputs, uint32_t input_count,
+                uint32_t* inputs, __attribute__((unused)) void** attributes, void* _plan) {
+    connx_ElementwisePlan* plan = _plan;
+
+    // A fused group has at least one input
+    if(input_count == 0) {
+        connx_error("Elementwise: No inputs.\n");
+        return CONNX_ILLEGAL_SYNTAX;
+    }
+
+    connx_Tensor* tensors[input_count];
+    int32_t ndim = 0;
+    for(uint32_t i = 0; i < input_count; i++) {
+        tensors[i] = connx_Context_get(context, inputs[i]);
+        if(tensors[i]->ndim > ndim) {
+            ndim = tensors[i]->ndim;
+        }
+    }
+
+    connx_DataType dtype = tensors[0]->dtype;
+
+    // The output is the broadcast of the inputs
+    int32_t shape[ndim + 1];
+    for(int32_t i = 0; i < ndim; i++) {
+        shape[i] = 1;
+    }
+
+    for(uint32_t i = 0; i < input_count; i++) {
+        connx_Tensor* tensor = tensors[i];
+        int32_t* dims = shape + ndim - tensor->ndim;
+
+        if(tensor->dtype != dtype) {
+            connx_error("Elementwise: Datatypes of the inputs are not the same.\n");
+            return CONNX_DATA_TYPE_NOT_MATCHING;
+        }
+
+        for(int32_t j = 0; j < tensor->ndim; j++) {
+            if(dims[j] == 1) {
+                dims[j] = tensor->shape[j];
+            } else if(tensor->shape[j] != 1 && tensor->shape[j] != dims[j]) {
+                connx_error("Elementwise: Shapes of the inputs cannot be broadcast.\n");
+                return CONNX_TENSOR_SHAPE_NOT_MATCHING;
+            }
+        }
+    }
+
+    if(dtype != CONNX_FLOAT32 && dtype != CONNX_FLOAT64) {
+        for(uint32_t i = 0; i < plan->count; i++) {
+            if(plan->instructions[i].op >= CONNX_ELEMENTWISE_LEAKY_RELU) {
+                connx_error("Elementwise: Datatype %d is not supported yet.\n", dtype);
+                return CONNX_NOT_SUPPORTED_DATATYPE;
+            }
+        }
+    }
+
+    int32_t total = connx_Int32_product(ndim, shape);
+
+    ElementwiseAccess accesses[input_count];
+    int32_t strides[input_count * ndim + 1];
+    for(uint32_t i = 0; i < input_count; i++) {
+        connx_Tensor* tensor = tensors[i];
+        int32_t count = connx_Int32_product(tensor->ndim, tensor->shape);
+
+        if(count == 1) {
+            accesses[i] = ELEMENTWISE_SCALAR;
+        } else if(count == total) {
+            accesses[i] = ELEMENTWISE_DIRECT;
+        } else {
+            accesses[i] = ELEMENTWISE_BROADCAST;
+
+            int32_t unit = 1;
+            for(int32_t j = ndim - 1; j >= 0; j--) {
+                int32_t k = j - (ndim - tensor->ndim);
+                if(k < 0 || tensor->shape[k] == 1) {
+                    strides[i * ndim + j] = 0;
+                } else {
+                    strides[i * ndim + j] = unit;
+                    unit *= tensor->shape[k];
+                }
+            }
+        }
+    }
+
+    connx_Tensor* Y = connx_Context_alloc_inplace(context, outputs[0], dtype, ndim, shape);
+    if(Y == NULL) {
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+
+    ElementwiseTask task = {plan, dtype, input_count, tensors, accesses, ndim, shape, strides, Y->buffer, CONNX_OK};
+
+    switch(dtype) {
+        TEMPLATE_START(UINT8, UINT16, UINT32, UINT64, INT8, INT16, INT32, INT64, FLOAT32, FLOAT64)
+#undef TEMPLATE_DTYPE
+#undef TEMPLATE_TYPE
+#define TEMPLATE_DTYPE FLOAT32
+#define TEMPLATE_TYPE float32_t
+        case TEMPLATE_DTYPE:
+            connx_parallel_for(total, BLOCK_SIZE * 16, _run_TEMPLATE_NAME, &task);
+            break;
+            TEMPLATE_END()
+        default:
+            connx_error("Elementwise: Datatype %d is not supported yet.\n", dtype);
+            connx_Tensor_unref(Y);
+            return CONNX_NOT_SUPPORTED_DATATYPE;
+    }
+
+    if(task.ret != CONNX_OK) {
+        connx_Tensor_unref(Y);
+        return task.ret;
+    }
+
+    connx_Context_set(context, outputs[0], Y);
+
+    return CONNX_OK;
+}
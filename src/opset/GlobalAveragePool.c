@@ -0,0 +1,63 @@
+#include <connx/accel.h>
+#include <connx/connx.h>
+
+int GlobalAveragePool_infer(connx_Graph* graph, connx_Node* node) {
+    connx_ValueInfo* X = connx_Graph_get_value_info(graph, node->inputs[0]);
+
+    int32_t shape[X->ndim];
+    for(int32_t i = 0; i < X->ndim; i++) {
+        shape[i] = i < 2 ? X->shape[i] : 1;
+    }
+
+    return connx_Graph_set_value_info(graph, node->outputs[0], X->dtype, X->ndim, shape);
+}
+
+int GlobalAveragePool(connx_Context* context, uint32_t output_count, uint32_t* outputs, uint32_t input_count,
+                      uint32_t* inputs, __attribute__((unused)) void** attributes,
+                      __attribute__((unused)) void* plan) {
+    connx_Tensor* X = connx_Context_get(context, inputs[0]);
+
+    // Y is (N, C, 1, 1, ...)
+    int32_t shape[X->ndim];
+    for(int32_t i = 0; i < X->ndim; i++) {
+        shape[i] = i < 2 ? X->shape[i] : 1;
+    }
+
+    connx_Tensor* Y = connx_Context_alloc(context, outputs[0], X->dtype, X->ndim, shape);
+    if(Y == NULL) {
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+
+    int32_t count = X->shape[0] * X->shape[1];
+    int32_t unit = connx_Int32_product(X->ndim - 2, X->shape + 2);
+
+    switch(X->dtype) {
+        TEMPLATE_START(FLOAT32, FLOAT64)
+#undef TEMPLATE_DTYPE
+#undef TEMPLATE_TYPE
+#define TEMPLATE_DTYPE FLOAT32
+#define TEMPLATE_TYPE float32_t
+        case TEMPLATE_DTYPE: {
+            TEMPLATE_TYPE* X_array = X->buffer;
+            TEMPLATE_TYPE* Y_array = Y->buffer;
+
+            for(int32_t i = 0; i < count; i++) {
+                TEMPLATE_TYPE sum = 0;
+                for(int32_t j = 0; j < unit; j++) {
+                    sum += X_array[i * unit + j];
+                }
+
+                Y_array[i] = sum / unit;
+            }
+            break;
+        }
+            TEMPLATE_END()
+        default:
+            connx_error("GlobalAveragePool: Datatype %d is not supported yet.\n", X->dtype);
+            return CONNX_NOT_SUPPORTED_DATATYPE;
+    }
+
+    connx_Context_set(context, outputs[0], Y);
+
+    return CONNX_OK;
+}
@@ -0,0 +1,37 @@
+#include <connx/accel.h>
+#include <connx/connx.h>
+
+int Log_infer(connx_Graph* graph, connx_Node* node) {
+    return connx_infer_elementwise(graph, node);
+}
+
+int Log(connx_Context* context, uint32_t output_count, uint32_t* outputs, uint32_t input_count, uint32_t* inputs,
+        __attribute__((unused)) void** attributes, __attribute__((unused)) void* plan) {
+    connx_Tensor* X = connx_Context_get(context, inputs[0]);
+    connx_Tensor* Y = connx_Context_alloc_inplace(context, outputs[0], X->dtype, X->ndim, X->shape);
+    if(Y == NULL) {
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+
+    int32_t total = connx_Int32_product(X->ndim, X->shape);
+
+    switch(X->dtype) {
+        TEMPLATE_START(FLOAT32, FLOAT64)
+#undef TEMPLATE_DTYPE
+#undef TEMPLATE_TYPE
+#define TEMPLATE_DTYPE FLOAT32
+#define TEMPLATE_TYPE float32_t
+        case TEMPLATE_DTYPE:
+            connx_TEMPLATE_NAME_log(total, Y->buffer, X->buffer);
+            break;
+            TEMPLATE_END()
+        default:
+            connx_error("Log: Datatype %d is not supported yet.\n", X->dtype);
+            connx_Tensor_unref(Y);
+            return CONNX_NOT_SUPPORTED_DATATYPE;
+    }
+
+    connx_Context_set(context, outputs[0], Y);
+
+    return CONNX_OK;
+}
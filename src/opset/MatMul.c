@@ -1,41 +1,65 @@
 #include <connx/accel.h>
 #include <connx/connx.h>
 
+/**
+ * Y is split into blocks of MATMUL_ROWS rows and MATMUL_COLUMNS columns of each matrix, which are multiplied by
+ * connx_gemm of the accel layer independently.
+ */
+#define MATMUL_ROWS 64
+#define MATMUL_COLUMNS 256
+
+// Matrices of A and B are broadcast to the matrices of Y by the index modulo the total
+typedef struct _MatMulTask {
+    connx_Tensor* Y;
+    connx_Tensor* A;
+    connx_Tensor* B;
+    int32_t A_col, A_unit, A_total;
+    int32_t B_col, B_unit, B_total;
+    int32_t Y_row, Y_col, Y_unit;
+    int ret;
+} MatMulTask;
+
 TEMPLATE_START(FLOAT32, FLOAT64, UINT32, UINT64, INT32, INT64)
 #undef TEMPLATE_DTYPE
 #undef TEMPLATE_TYPE
 #define TEMPLATE_DTYPE FLOAT32
 #define TEMPLATE_TYPE float32_t
-#define connx_TEMPLATE_NAME_broadcast connx_Float32_broadcast
-static TEMPLATE_TYPE* get_TEMPLATE_NAME_row(int32_t temp_count, TEMPLATE_TYPE* temp, int32_t array_count,
-                                            TEMPLATE_TYPE* array, int32_t row) {
-    if(array_count >= temp_count) {
-        return array + row * array_count;
-    } else {
-        connx_TEMPLATE_NAME_broadcast(temp_count, temp, array_count, array + row * array_count);
-        return temp;
-    }
-}
-
-static TEMPLATE_TYPE* get_TEMPLATE_NAME_col(int32_t temp_count, TEMPLATE_TYPE* temp, int32_t array_count,
-                                            TEMPLATE_TYPE* array, int32_t col) {
-    for(int32_t i = 0; i < temp_count; i++) {
-        temp[i] = array[i * array_count + col];
+static void _matmul_TEMPLATE_NAME(void* context, int32_t start, int32_t end) {
+    MatMulTask* task = context;
+    TEMPLATE_TYPE* A_array = task->A->buffer;
+    TEMPLATE_TYPE* B_array = task->B->buffer;
+    TEMPLATE_TYPE* Y_array = task->Y->buffer;
+
+    int32_t row_count = (task->Y_row + MATMUL_ROWS - 1) / MATMUL_ROWS;
+    int32_t col_count = (task->Y_col + MATMUL_COLUMNS - 1) / MATMUL_COLUMNS;
+
+    for(int32_t i = start; i < end; i++) {
+        int32_t col = i % col_count * MATMUL_COLUMNS;
+        int32_t row = i / col_count % row_count * MATMUL_ROWS;
+        int32_t matrix = i / col_count / row_count;
+        int32_t rows = task->Y_row - row < MATMUL_ROWS ? task->Y_row - row : MATMUL_ROWS;
+        int32_t cols = task->Y_col - col < MATMUL_COLUMNS ? task->Y_col - col : MATMUL_COLUMNS;
+
+        TEMPLATE_TYPE* a = A_array + (matrix * task->A_unit) % task->A_total + row * task->A_col;
+        TEMPLATE_TYPE* b = B_array + (matrix * task->B_unit) % task->B_total + col;
+        TEMPLATE_TYPE* y = Y_array + matrix * task->Y_unit + row * task->Y_col + col;
+
+        if(connx_TEMPLATE_NAME_gemm(rows, cols, task->A_col, a, task->A_col, b, task->B_col, y, task->Y_col) !=
+           CONNX_OK) {
+            connx_error("Out of memory\n");
+            __atomic_store_n(&task->ret, CONNX_NOT_ENOUGH_MEMORY, __ATOMIC_RELAXED);
+            return;
+        }
     }
-    return temp;
 }
 TEMPLATE_END()
 
-int MatMul(connx_Graph* graph, uint32_t output_count, uint32_t* outputs, uint32_t input_count, uint32_t* inputs, __attribute__((unused)) void** attributes) {
-    connx_Tensor* A = connx_Graph_get(graph, inputs[0]);
-    connx_Tensor* B = connx_Graph_get(graph, inputs[1]);
-
-    // Create Y
-    int32_t ndim = A->ndim > B->ndim ? A->ndim : B->ndim;
-    int32_t shape[ndim];
+// Shape of Y, rows of A and columns of B preceded by the larger of the batch dimensions
+static void get_output_shape(int32_t A_ndim, int32_t* A_shape, int32_t B_ndim, int32_t* B_shape, int32_t ndim,
+                             int32_t* shape) {
     for(int32_t i = 0; i < ndim; i++) { // back to front
-        int32_t A_dim = i < A->ndim ? A->shape[A->ndim - 1 - i] : 0;
-        int32_t B_dim = i < B->ndim ? B->shape[B->ndim - 1 - i] : 0;
+        int32_t A_dim = i < A_ndim ? A_shape[A_ndim - 1 - i] : 0;
+        int32_t B_dim = i < B_ndim ? B_shape[B_ndim - 1 - i] : 0;
 
         if(i == 0) {
             A_dim = 0;
@@ -45,8 +69,47 @@ int MatMul(connx_Graph* graph, uint32_t output_count, uint32_t* outputs, uint32_
 
         shape[ndim - i - 1] = A_dim > B_dim ? A_dim : B_dim;
     }
+}
+
+int MatMul_infer(connx_Graph* graph, connx_Node* node) {
+    connx_ValueInfo* A = connx_Graph_get_value_info(graph, node->inputs[0]);
+    connx_ValueInfo* B = connx_Graph_get_value_info(graph, node->inputs[1]);
+
+    // Vectors are not supported by MatMul yet, Y is left unknown
+    if(A->ndim < 2 || B->ndim < 2) {
+        return CONNX_OK;
+    }
+
+    if(A->shape[A->ndim - 1] != B->shape[B->ndim - 2]) {
+        connx_error("MatMul: Columns of A (%d) and rows of B (%d) are not matching.\n", A->shape[A->ndim - 1],
+                    B->shape[B->ndim - 2]);
+        return CONNX_TENSOR_SHAPE_NOT_MATCHING;
+    }
+
+    int32_t ndim = A->ndim > B->ndim ? A->ndim : B->ndim;
+    int32_t shape[ndim];
+    get_output_shape(A->ndim, A->shape, B->ndim, B->shape, ndim, shape);
+
+    return connx_Graph_set_value_info(graph, node->outputs[0], A->dtype, ndim, shape);
+}
+
+int MatMul(connx_Context* context, uint32_t output_count, uint32_t* outputs, uint32_t input_count, uint32_t* inputs,
+           __attribute__((unused)) void** attributes, __attribute__((unused)) void* plan) {
+    connx_Tensor* A = connx_Context_get(context, inputs[0]);
+    connx_Tensor* B = connx_Context_get(context, inputs[1]);
+
+    if(A->shape[A->ndim - 1] != B->shape[B->ndim - 2]) {
+        connx_error("MatMul: Columns of A (%d) and rows of B (%d) are not matching.\n", A->shape[A->ndim - 1],
+                    B->shape[B->ndim - 2]);
+        return CONNX_TENSOR_SHAPE_NOT_MATCHING;
+    }
 
-    connx_Tensor* Y = connx_Tensor_alloc(A->dtype, ndim, shape);
+    // Create Y
+    int32_t ndim = A->ndim > B->ndim ? A->ndim : B->ndim;
+    int32_t shape[ndim];
+    get_output_shape(A->ndim, A->shape, B->ndim, B->shape, ndim, shape);
+
+    connx_Tensor* Y = connx_Context_alloc(context, outputs[0], A->dtype, ndim, shape);
     if(Y == NULL) {
         return CONNX_NOT_ENOUGH_MEMORY;
     }
@@ -64,50 +127,40 @@ int MatMul(connx_Graph* graph, uint32_t output_count, uint32_t* outputs, uint32_
     int32_t Y_unit = Y_row * Y_col;
     int32_t Y_total = connx_Int32_product(Y->ndim, Y->shape);
 
+    // An empty tensor
+    if(Y_total == 0) {
+        connx_Context_set(context, outputs[0], Y);
+        return CONNX_OK;
+    }
+
+    MatMulTask task = {Y, A, B, A_col, A_unit, A_total, B_col, B_unit, B_total, Y_row, Y_col, Y_unit, CONNX_OK};
+
+    int32_t block_count = Y_total / Y_unit * ((Y_row + MATMUL_ROWS - 1) / MATMUL_ROWS) *
+                          ((Y_col + MATMUL_COLUMNS - 1) / MATMUL_COLUMNS);
+
     switch(A->dtype) {
         TEMPLATE_START(FLOAT32, FLOAT64, UINT32, UINT64, INT32, INT64)
 #undef TEMPLATE_DTYPE
 #undef TEMPLATE_TYPE
 #define TEMPLATE_DTYPE FLOAT32
 #define TEMPLATE_TYPE float32_t
-#define connx_TEMPLATE_NAME_mul connx_Float32_mul
-#define connx_TEMPLATE_NAME_sum connx_Float32_sum
-        case TEMPLATE_DTYPE: {
-            TEMPLATE_TYPE* A_array = A->buffer;
-            TEMPLATE_TYPE* B_array = B->buffer;
-            TEMPLATE_TYPE* Y_array = Y->buffer;
-
-            int32_t count = A_col > B_row ? A_col : B_row; // count = MAX(A_col, B_row)
-            TEMPLATE_TYPE tmp_a[count];
-            TEMPLATE_TYPE tmp_b[count];
-            TEMPLATE_TYPE tmp_mul[count];
-
-            for(int32_t Y_idx = 0, A_idx = 0, B_idx = 0; Y_idx < Y_total;
-                Y_idx += Y_unit, A_idx = (A_idx + A_unit) % A_total, B_idx = (B_idx + B_unit) % B_total) {
-
-                for(int32_t col_idx = 0; col_idx < Y_col; col_idx++) {
-                    TEMPLATE_TYPE* b = get_TEMPLATE_NAME_col(count, tmp_a, B_col, B_array + B_idx, col_idx);
-
-                    for(int32_t row_idx = 0; row_idx < Y_row; row_idx++) {
-                        TEMPLATE_TYPE* a = get_TEMPLATE_NAME_row(count, tmp_b, A_col, A_array + A_idx, row_idx);
-
-                        // Mul
-                        connx_TEMPLATE_NAME_mul(count, tmp_mul, a, b);
-
-                        // Sum
-                        Y_array[Y_idx + row_idx * Y_col + col_idx] = connx_TEMPLATE_NAME_sum(count, tmp_mul);
-                    }
-                }
-            }
+        case TEMPLATE_DTYPE:
+            connx_parallel_for(block_count, 1, _matmul_TEMPLATE_NAME, &task);
             break;
-        }
             TEMPLATE_END()
         default:
             connx_error("MatMul: Datatype %d is not supported yet.\n", A->dtype);
+            connx_Tensor_unref(Y);
             return CONNX_NOT_SUPPORTED_DATATYPE;
     }
 
-    connx_Graph_set(graph, outputs[0], Y);
+    // Packing buffers of a task are not allocated
+    if(task.ret != CONNX_OK) {
+        connx_Tensor_unref(Y);
+        return task.ret;
+    }
+
+    connx_Context_set(context, outputs[0], Y);
 
     return CONNX_OK;
 }
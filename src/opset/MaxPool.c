@@ -1,93 +1,183 @@
 #include <math.h>
 #include <string.h>
-#include <strings.h> // bzero
 #include <connx/accel.h>
 #include <connx/connx.h>
 
-int MaxPool(connx_Graph* graph, uint32_t output_count, uint32_t* outputs, uint32_t input_count, uint32_t* inputs, void** attributes) {
-	// inputs
-    connx_Tensor* X = connx_Graph_get(graph, inputs[0]);
+// Attributes decoded by MaxPool_prepare
+typedef struct _MaxPoolPlan {
+    connx_AutoPad auto_pad;
+    int32_t ceil_mode;
+    int32_t storage_order;
+    int32_t feature_dim;
+    int32_t* dilations;
+    int32_t* kernel_shape;
+    int32_t* pads;   // pads of SAME_UPPER and SAME_LOWER are calculated from the input shape on each run
+    int32_t* strides;
+    int32_t* k_iter; // kernel iterator which is ready to run
+    int32_t array[0];
+} MaxPoolPlan;
+
+// Output spatial shape and pads of the input spatial shape
+static void get_output_shape(MaxPoolPlan* plan, int32_t* feature_shape, int32_t* output_shape, int32_t* pads) {
+    int32_t feature_dim = plan->feature_dim;
+    int32_t* dilations = plan->dilations;
+    int32_t* kernel_shape = plan->kernel_shape;
+    int32_t* strides = plan->strides;
+
+    memcpy(pads, plan->pads, sizeof(int32_t) * feature_dim * 2);
+
+    switch(plan->auto_pad) {
+        case CONNX_AUTO_PAD_NOTSET:
+            if(plan->ceil_mode == 0) {
+                for(int i = 0; i < feature_dim; i++) {
+                    output_shape[i] = (feature_shape[i] + pads[i] + pads[i + feature_dim] - ((kernel_shape[i] - 1) * dilations[i] + 1)) / strides[i] + 1;
+                }
+            } else {
+                for(int i = 0; i < feature_dim; i++) {
+                    output_shape[i] = ceilf((float)(feature_shape[i] + pads[i] + pads[i + feature_dim] - ((kernel_shape[i] - 1) * dilations[i] + 1)) / strides[i] + 1);
+                }
+            }
+            break;
+        case CONNX_AUTO_PAD_VALID:
+            for(int i = 0; i < feature_dim; i++) {
+                output_shape[i] = ceilf((float)(feature_shape[i] - ((kernel_shape[i] - 1) * dilations[i] + 1) + 1) / strides[i]);
+            }
+            break;
+        case CONNX_AUTO_PAD_SAME_UPPER:
+            for(int i = 0; i < feature_dim; i++) {
+                output_shape[i] = ceilf((float)feature_shape[i] / strides[i]);
+                int32_t pad = (output_shape[i] - 1) * strides[i] + ((kernel_shape[i] - 1) * dilations[i] + 1) - feature_shape[i];
+                pads[i] = pads[i + feature_dim] = pad / 2;
+                if(pad % 2 == 1) {
+                    pads[i + feature_dim]++;
+                }
+            }
+            break;
+        case CONNX_AUTO_PAD_SAME_LOWER:
+            for(int i = 0; i < feature_dim; i++) {
+                output_shape[i] = ceilf((float)feature_shape[i] / strides[i]);
+                int32_t pad = (output_shape[i] - 1) * strides[i] + ((kernel_shape[i] - 1) * dilations[i] + 1) - feature_shape[i];
+                pads[i] = pads[i + feature_dim] = pad / 2;
+                if(pad % 2 == 1) {
+                    pads[i]++;
+                }
+            }
+            break;
+    }
+}
 
-	// attributes
-	char* auto_pad = attributes[0];
-	int32_t ceil_mode = *(int32_t*)attributes[1];
-	connx_AttributeInts* _dilations = attributes[2];
-	connx_AttributeInts* _kernel_shape = attributes[3];
-	connx_AttributeInts* _pads = attributes[4];
-	int32_t storage_order = *(int32_t*)attributes[5];
-	connx_AttributeInts* _strides = attributes[6];
+int MaxPool_prepare(__attribute__((unused)) connx_Graph* graph, connx_Node* node) {
+    char* auto_pad = node->attributes[0];
+    int32_t ceil_mode = *(int32_t*)node->attributes[1];
+    connx_AttributeInts* _dilations = node->attributes[2];
+    connx_AttributeInts* _kernel_shape = node->attributes[3];
+    connx_AttributeInts* _pads = node->attributes[4];
+    int32_t storage_order = *(int32_t*)node->attributes[5];
+    connx_AttributeInts* _strides = node->attributes[6];
+
+    if(_kernel_shape->count == 0) {
+        connx_error("MaxPool: kernel_shape is required.\n");
+        return CONNX_NOT_SUPPORTED_ATTRIBUTE;
+    }
 
-	// feature dimension
-	int32_t feature_dim = X->ndim - 2;
-	int32_t* feature_shape = X->shape + 2;
+    int32_t feature_dim = _kernel_shape->count;
 
-	// default attribute setting
-    int32_t dilations[feature_dim];
-    if(_dilations->count == 0) {
-        for(uint32_t i = 0; i < feature_dim; i++) {
-            dilations[i] = 1;
-        }
-    } else {
-        memcpy(dilations, _dilations->array, sizeof(int32_t) * feature_dim);
+    // dilations, kernel_shape, pads, strides and k_iter
+    MaxPoolPlan* plan = connx_alloc(sizeof(MaxPoolPlan) + sizeof(int32_t) * (feature_dim * 5 + connx_Iterator_size(feature_dim)));
+    if(plan == NULL) {
+        connx_error("Out of memory\n");
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+    node->plan = plan;
+
+    plan->ceil_mode = ceil_mode;
+    plan->storage_order = storage_order;
+    plan->feature_dim = feature_dim;
+    plan->dilations = plan->array;
+    plan->kernel_shape = plan->dilations + feature_dim;
+    plan->pads = plan->kernel_shape + feature_dim;
+    plan->strides = plan->pads + feature_dim * 2;
+    plan->k_iter = plan->strides + feature_dim;
+
+    int ret = connx_AutoPad_parse(auto_pad, &plan->auto_pad);
+    if(ret == CONNX_OK) {
+        ret = connx_AttributeInts_get(_dilations, feature_dim, plan->dilations, 1);
+    }
+    if(ret == CONNX_OK) {
+        ret = connx_AttributeInts_get(_kernel_shape, feature_dim, plan->kernel_shape, 0);
+    }
+    if(ret == CONNX_OK) {
+        ret = connx_AttributeInts_get(_pads, feature_dim * 2, plan->pads, 0);
+    }
+    if(ret == CONNX_OK) {
+        ret = connx_AttributeInts_get(_strides, feature_dim, plan->strides, 1);
+    }
+    if(ret != CONNX_OK) {
+        return ret;
     }
 
-    int32_t* kernel_shape = _kernel_shape->array;
+    int32_t starts[feature_dim];
+    int32_t stops[feature_dim];
+    for(int32_t i = 0; i < feature_dim; i++) {
+        starts[i] = 0;
+        stops[i] = plan->kernel_shape[i] * plan->dilations[i];
+    }
 
-    int32_t pads[feature_dim * 2];
-    if(_pads->count == 0) {
-        for(uint32_t i = 0; i < feature_dim * 2; i++) {
-            pads[i] = 0;
-        }
-    } else {
-        memcpy(pads, _pads->array, sizeof(int32_t) * feature_dim * 2);
+    connx_Iterator_init(plan->k_iter, feature_dim, starts, stops, plan->dilations);
+
+    return CONNX_OK;
+}
+
+int MaxPool_infer(connx_Graph* graph, connx_Node* node) {
+    MaxPoolPlan* plan = node->plan;
+    connx_ValueInfo* X = connx_Graph_get_value_info(graph, node->inputs[0]);
+
+    if(X->ndim != 2 + plan->feature_dim) {
+        connx_error("MaxPool: X must be %d dimensional.\n", 2 + plan->feature_dim);
+        return CONNX_TENSOR_SHAPE_NOT_MATCHING;
     }
 
-    int32_t strides[feature_dim];
-    if(_strides->count == 0) {
-        for(uint32_t i = 0; i < feature_dim; i++) {
-            strides[i] = 1;
-        }
-    } else {
-        memcpy(strides, _strides->array, sizeof(int32_t) * feature_dim);
+    int32_t Y_shape[X->ndim];
+    int32_t pads[plan->feature_dim * 2];
+    Y_shape[0] = X->shape[0];
+    Y_shape[1] = X->shape[1];
+    get_output_shape(plan, X->shape + 2, Y_shape + 2, pads);
+
+    int ret = connx_Graph_set_value_info(graph, node->outputs[0], X->dtype, X->ndim, Y_shape);
+    if(ret == CONNX_OK && node->output_count > 1) {
+        ret = connx_Graph_set_value_info(graph, node->outputs[1], CONNX_INT64, X->ndim, Y_shape);
+    }
+
+    return ret;
+}
+
+int MaxPool(connx_Context* context, uint32_t output_count, uint32_t* outputs, uint32_t input_count, uint32_t* inputs,
+            __attribute__((unused)) void** attributes, void* _plan) {
+	// inputs
+    connx_Tensor* X = connx_Context_get(context, inputs[0]);
+
+	// attributes
+    MaxPoolPlan* plan = _plan;
+    int32_t storage_order = plan->storage_order;
+    int32_t* strides = plan->strides;
+
+	// feature dimension
+	int32_t feature_dim = plan->feature_dim;
+	int32_t* feature_shape = X->shape + 2;
+
+    if(X->ndim != 2 + feature_dim) {
+        connx_error("MaxPool: X must be %d dimensional.\n", 2 + feature_dim);
+        return CONNX_TENSOR_SHAPE_NOT_MATCHING;
     }
 
     // output_spatial_shape
     int32_t output_shape[feature_dim];
-    bzero(output_shape, sizeof(int32_t) * feature_dim);
+    int32_t pads[feature_dim * 2];
+    get_output_shape(plan, feature_shape, output_shape, pads);
 
-    if(strcmp(auto_pad, "NOTSET") == 0) {
-        if(ceil_mode == 0) {
-            for(int i = 0; i < feature_dim; i++) {
-                output_shape[i] = (feature_shape[i] + pads[i] + pads[i + feature_dim] - ((kernel_shape[i] - 1) * dilations[i] + 1)) / strides[i] + 1;
-            }
-        } else {
-            for(int i = 0; i < feature_dim; i++) {
-                output_shape[i] = ceilf((float)(feature_shape[i] + pads[i] + pads[i + feature_dim] - ((kernel_shape[i] - 1) * dilations[i] + 1)) / strides[i] + 1);
-            }
-        }
-    } else if(strcmp(auto_pad, "VALID") == 0) {
-        for(int i = 0; i < feature_dim; i++) {
-            output_shape[i] = ceilf((float)(feature_shape[i] - ((kernel_shape[i] - 1) * dilations[i] + 1) + 1) / strides[i]);
-        }
-    } else if(strcmp(auto_pad, "SAME_UPPER") == 0) {
-        for(int i = 0; i < feature_dim; i++) {
-            output_shape[i] = ceilf((float)feature_shape[i] / strides[i]);
-            int32_t pad = (output_shape[i] - 1) * strides[i] + ((kernel_shape[i] - 1) * dilations[i] + 1) - feature_shape[i];
-            pads[i] = pads[i + feature_dim] = pad / 2;
-            if(pad % 2 == 1) {
-                pads[i + feature_dim]++;
-            }
-        }
-    } else if(strcmp(auto_pad, "SAME_LOWER") == 0) {
-        for(int i = 0; i < feature_dim; i++) {
-            output_shape[i] = ceilf((float)feature_shape[i] / strides[i]);
-            int32_t pad = (output_shape[i] - 1) * strides[i] + ((kernel_shape[i] - 1) * dilations[i] + 1) - feature_shape[i];
-            pads[i] = pads[i + feature_dim] = pad / 2;
-            if(pad % 2 == 1) {
-                pads[i]++;
-            }
-        }
-    }
+    // Kernel iterator returns to its start after each window
+    int32_t k_iter[connx_Iterator_size(feature_dim)];
+    memcpy(k_iter, plan->k_iter, sizeof(k_iter));
 
     // MaxPool
     int32_t Y_shape[2 + feature_dim];
@@ -95,11 +185,11 @@ int MaxPool(connx_Graph* graph, uint32_t output_count, uint32_t* outputs, uint32
     Y_shape[1] = X->shape[1];
     memcpy(Y_shape + 2, output_shape, sizeof(int32_t) * feature_dim);
 
-    connx_Tensor* Y = connx_Tensor_alloc(X->dtype, 2 + feature_dim, Y_shape);
+    connx_Tensor* Y = connx_Context_alloc(context, outputs[0], X->dtype, 2 + feature_dim, Y_shape);
     connx_Tensor* Indices = NULL;
     int64_t* Indices_array = NULL;
     if(output_count > 1) {
-        Indices = connx_Tensor_alloc(CONNX_INT64, 2 + feature_dim, Y_shape);
+        Indices = connx_Context_alloc(context, outputs[1], CONNX_INT64, 2 + feature_dim, Y_shape);
         Indices_array = (int64_t*)Indices->buffer;
     }
 
@@ -139,16 +229,14 @@ int MaxPool(connx_Graph* graph, uint32_t output_count, uint32_t* outputs, uint32
                 for(int32_t channel = 0; channel < channel_count; channel++) {
                     int32_t starts[feature_dim];
                     int32_t stops[feature_dim];
-                    int32_t steps[feature_dim];
 
                     for(int32_t i = 0; i < feature_dim; i++) {
                         starts[i] = -pads[i];
                         stops[i] = -pads[i] + output_shape[i] * strides[i];
-                        steps[i] = strides[i];
                     }
 
                     int32_t x_iter[connx_Iterator_size(feature_dim)];
-                    connx_Iterator_init(x_iter, feature_dim, starts, stops, steps);
+                    connx_Iterator_init(x_iter, feature_dim, starts, stops, strides);
 
                     while(connx_Iterator_next(x_iter)) {
                         int32_t* x_idx = connx_Iterator_index(x_iter);
@@ -156,15 +244,6 @@ int MaxPool(connx_Graph* graph, uint32_t output_count, uint32_t* outputs, uint32
                         TEMPLATE_TYPE y = 0;
                         int64_t argmax_idx = -1;
 
-                        for(int32_t i = 0; i < feature_dim; i++) {
-                            starts[i] = 0;
-                            stops[i] = kernel_shape[i] * dilations[i];
-                            steps[i] = dilations[i];
-                        }
-
-                        int32_t k_iter[connx_Iterator_size(feature_dim)];
-                        connx_Iterator_init(k_iter, feature_dim, starts, stops, steps);
-
                         while(connx_Iterator_next(k_iter)) {
                             int32_t* k_idx = connx_Iterator_index(k_iter);
                             int32_t d_idx[feature_dim];
@@ -218,9 +297,9 @@ skip_TEMPLATE_NAME:
             return CONNX_NOT_SUPPORTED_DATATYPE;
     }
 
-    connx_Graph_set(graph, outputs[0], Y);
+    connx_Context_set(context, outputs[0], Y);
     if(output_count > 1) {
-        connx_Graph_set(graph, outputs[1], Indices);
+        connx_Context_set(context, outputs[1], Indices);
     }
 
     return CONNX_OK;
@@ -1,9 +1,14 @@
 #include <connx/accel.h>
 #include <connx/connx.h>
 
-int Relu(connx_Graph* graph, uint32_t output_count, uint32_t* outputs, uint32_t input_count, uint32_t* inputs, __attribute__((unused)) void** attributes) {
-    connx_Tensor* X = connx_Graph_get(graph, inputs[0]);
-    connx_Tensor* Y = connx_Tensor_alloc_like(X);
+int Relu_infer(connx_Graph* graph, connx_Node* node) {
+    return connx_infer_elementwise(graph, node);
+}
+
+int Relu(connx_Context* context, uint32_t output_count, uint32_t* outputs, uint32_t input_count, uint32_t* inputs,
+         __attribute__((unused)) void** attributes, __attribute__((unused)) void* plan) {
+    connx_Tensor* X = connx_Context_get(context, inputs[0]);
+    connx_Tensor* Y = connx_Context_alloc_inplace(context, outputs[0], X->dtype, X->ndim, X->shape);
     if(Y == NULL) {
         return CONNX_NOT_ENOUGH_MEMORY;
     }
@@ -28,10 +33,11 @@ int Relu(connx_Graph* graph, uint32_t output_count, uint32_t* outputs, uint32_t
             TEMPLATE_END()
         default:
             connx_error("Relu: Datatype %d is not supported yet.\n", X->dtype);
+            connx_Tensor_unref(Y);
             return CONNX_NOT_SUPPORTED_DATATYPE;
     }
 
-    connx_Graph_set(graph, outputs[0], Y);
+    connx_Context_set(context, outputs[0], Y);
 
     return CONNX_OK;
 }
@@ -1,13 +1,10 @@
 #include <connx/accel.h>
 #include <connx/connx.h>
 
-int Reshape(connx_Graph* graph, uint32_t output_count, uint32_t* outputs, uint32_t input_count, uint32_t* inputs, void** attributes) {
-    connx_Tensor* data = connx_Graph_get(graph, inputs[0]);
-    connx_Tensor* shape = connx_Graph_get(graph, inputs[1]);
-    int32_t allowzero = *(int32_t*)attributes[0];
-
+// Resolve the 0 (copy) and -1 (inferred) dimensions of shape
+static void get_shape(int32_t data_ndim, int32_t* data_shape, connx_Tensor* shape, int32_t allowzero,
+                      int32_t* new_shape) {
     int32_t ndim = shape->shape[0];
-    int32_t new_shape[ndim];
 
     // Copy tensor shape to array new_shape
     int32_t negative_idx = -1;
@@ -15,7 +12,7 @@ int Reshape(connx_Graph* graph, uint32_t output_count, uint32_t* outputs, uint32
         new_shape[i] = ((int64_t*)shape->buffer)[i];
 
         if(allowzero == 0 && new_shape[i] == 0) {
-            new_shape[i] = data->shape[i];
+            new_shape[i] = data_shape[i];
         }
 
         if(new_shape[i] == -1) {
@@ -25,13 +22,41 @@ int Reshape(connx_Graph* graph, uint32_t output_count, uint32_t* outputs, uint32
 
     // Process -1 dim
     if(negative_idx >= 0) {
-        int32_t total = connx_Int32_product(data->ndim, data->shape);
+        int32_t total = connx_Int32_product(data_ndim, data_shape);
 
         new_shape[negative_idx] = 1;
         int32_t remain = connx_Int32_product(ndim, new_shape);
 
         new_shape[negative_idx] = total / remain;
     }
+}
+
+int Reshape_infer(connx_Graph* graph, connx_Node* node) {
+    connx_ValueInfo* data = connx_Graph_get_value_info(graph, node->inputs[0]);
+    connx_Tensor* shape = connx_Graph_get_constant(graph, node->inputs[1]);
+    int32_t allowzero = *(int32_t*)node->attributes[0];
+
+    // The shape is known only when it is an initializer
+    if(shape == NULL) {
+        return CONNX_OK;
+    }
+
+    int32_t ndim = shape->shape[0];
+    int32_t new_shape[ndim + 1];
+    get_shape(data->ndim, data->shape, shape, allowzero, new_shape);
+
+    return connx_Graph_set_value_info(graph, node->outputs[0], data->dtype, ndim, new_shape);
+}
+
+int Reshape(connx_Context* context, uint32_t output_count, uint32_t* outputs, uint32_t input_count, uint32_t* inputs,
+            void** attributes, __attribute__((unused)) void* plan) {
+    connx_Tensor* data = connx_Context_get(context, inputs[0]);
+    connx_Tensor* shape = connx_Context_get(context, inputs[1]);
+    int32_t allowzero = *(int32_t*)attributes[0];
+
+    int32_t ndim = shape->shape[0];
+    int32_t new_shape[ndim];
+    get_shape(data->ndim, data->shape, shape, allowzero, new_shape);
 
     // Make a reshaped tensor
     connx_Tensor* reshaped = connx_Tensor_reshape(data, ndim, new_shape);
@@ -39,7 +64,7 @@ int Reshape(connx_Graph* graph, uint32_t output_count, uint32_t* outputs, uint32
         return CONNX_NOT_ENOUGH_MEMORY;
     }
 
-    connx_Graph_set(graph, outputs[0], reshaped);
+    connx_Context_set(context, outputs[0], reshaped);
 
     return CONNX_OK;
 }
@@ -0,0 +1,996 @@
+#include <math.h>
+#include <string.h>
+#include <connx/accel.h>
+#include <connx/connx.h>
+#include <connx/hal.h>
+
+/**
+ * Graph optimization
+ *
+ * The graph is rewritten once when it is loaded, after the nodes are prepared and before it is analyzed (uses, DAG
+ * and memory plan), so the removed nodes cost nothing on each run.
+ *
+ * Value_infos 1..initializer_count are the initializers, so the id of a new initializer is swapped with the first id
+ * after the initializers.
+ */
+
+static void swap(uint32_t* id, uint32_t a, uint32_t b) {
+    if(*id == a) {
+        *id = b;
+    } else if(*id == b) {
+        *id = a;
+    }
+}
+
+// Swap value_info ids a and b in the nodes, the graph inputs and the graph outputs
+static void swap_id(connx_Graph* graph, uint32_t a, uint32_t b) {
+    for(uint32_t i = 0; i < graph->node_count; i++) {
+        connx_Node* node = graph->nodes[i];
+
+        for(uint32_t j = 0; j < node->output_count; j++) {
+            swap(&node->outputs[j], a, b);
+        }
+
+        for(uint32_t j = 0; j < node->input_count; j++) {
+            swap(&node->inputs[j], a, b);
+        }
+    }
+
+    for(uint32_t i = 0; i < graph->input_count; i++) {
+        swap(&graph->inputs[i], a, b);
+    }
+
+    for(uint32_t i = 0; i < graph->output_count; i++) {
+        swap(&graph->outputs[i], a, b);
+    }
+}
+
+// Make value_info id the next initializer, the graph takes the reference of tensor
+static int add_initializer(connx_Graph* graph, uint32_t id, connx_Tensor* tensor) {
+    uint32_t count = graph->initializer_count;
+
+    connx_Tensor** initializers = connx_alloc(sizeof(connx_Tensor*) * (count + 1));
+    void** mappings = connx_alloc(sizeof(void*) * (count + 1));
+    uint32_t* mapping_sizes = connx_alloc(sizeof(uint32_t) * (count + 1));
+    if(initializers == NULL || mappings == NULL || mapping_sizes == NULL) {
+        if(initializers != NULL) {
+            connx_free(initializers);
+        }
+
+        if(mappings != NULL) {
+            connx_free(mappings);
+        }
+
+        if(mapping_sizes != NULL) {
+            connx_free(mapping_sizes);
+        }
+
+        connx_error("Out of memory\n");
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+
+    memcpy(initializers, graph->initializers, sizeof(connx_Tensor*) * count);
+    initializers[count] = tensor;
+
+    // Initializers of the binary model have no mappings of their own
+    if(graph->mappings != NULL) {
+        memcpy(mappings, graph->mappings, sizeof(void*) * count);
+        memcpy(mapping_sizes, graph->mapping_sizes, sizeof(uint32_t) * count);
+        connx_free(graph->mappings);
+        connx_free(graph->mapping_sizes);
+    }
+
+    if(graph->initializers != NULL) {
+        connx_free(graph->initializers);
+    }
+
+    graph->initializers = initializers;
+    graph->mappings = mappings;
+    graph->mapping_sizes = mapping_sizes;
+    graph->initializer_count = count + 1;
+
+    swap_id(graph, id, count + 1);
+
+    return CONNX_OK;
+}
+
+// Index + 1 of the producer node and the number of uses of each value_info, the graph outputs are uses too
+static void find_producers(connx_Graph* graph, uint32_t* producers, uint32_t* use_counts) {
+    for(uint32_t i = 0; i < graph->node_count; i++) {
+        connx_Node* node = graph->nodes[i];
+
+        for(uint32_t j = 0; j < node->input_count; j++) {
+            use_counts[node->inputs[j]]++;
+        }
+
+        for(uint32_t j = 0; j < node->output_count; j++) {
+            producers[node->outputs[j]] = i + 1;
+        }
+    }
+
+    for(uint32_t i = 0; i < graph->output_count; i++) {
+        use_counts[graph->outputs[i]]++;
+    }
+}
+
+static void remove_nodes(connx_Graph* graph, bool* is_removeds) {
+    uint32_t count = 0;
+    for(uint32_t i = 0; i < graph->node_count; i++) {
+        if(is_removeds[i]) {
+            connx_Node_destroy(graph->nodes[i]);
+        } else {
+            graph->nodes[count++] = graph->nodes[i];
+        }
+    }
+    graph->node_count = count;
+}
+
+/**
+ * Initializers which are not used anymore, the inputs of the folded nodes and the weights replaced by the merges, are
+ * released. The last initializer takes the id of a removed one, so the initializers stay 1..initializer_count.
+ */
+static int remove_unused_initializers(connx_Graph* graph) {
+    uint32_t* producers = connx_alloc(sizeof(uint32_t) * (graph->value_info_count + 1)); // node index + 1
+    uint32_t* use_counts = connx_alloc(sizeof(uint32_t) * (graph->value_info_count + 1));
+
+    int ret = CONNX_OK;
+
+    if(producers == NULL || use_counts == NULL) {
+        connx_error("Out of memory\n");
+        ret = CONNX_NOT_ENOUGH_MEMORY;
+        goto done;
+    }
+
+    find_producers(graph, producers, use_counts);
+
+    // An initializer can be the default value of a graph input
+    for(uint32_t i = 0; i < graph->input_count; i++) {
+        use_counts[graph->inputs[i]]++;
+    }
+
+    // Backward, so the last initializer which takes the id of a removed one is used
+    for(uint32_t id = graph->initializer_count; id > 0; id--) {
+        if(use_counts[id] != 0) {
+            continue;
+        }
+
+        uint32_t last = graph->initializer_count;
+
+        connx_Tensor_unref(graph->initializers[id - 1]);
+        graph->initializers[id - 1] = graph->initializers[last - 1];
+        graph->initializers[last - 1] = NULL;
+
+        // Initializers of the binary model have no mappings of their own
+        if(graph->mappings != NULL) {
+            if(graph->mappings[id - 1] != NULL) {
+                connx_unmap(graph->mappings[id - 1], graph->mapping_sizes[id - 1]);
+            }
+
+            graph->mappings[id - 1] = graph->mappings[last - 1];
+            graph->mapping_sizes[id - 1] = graph->mapping_sizes[last - 1];
+            graph->mappings[last - 1] = NULL;
+        }
+
+        swap_id(graph, id, last);
+        graph->initializer_count--;
+    }
+
+done:
+    if(producers != NULL) {
+        connx_free(producers);
+    }
+
+    if(use_counts != NULL) {
+        connx_free(use_counts);
+    }
+
+    return ret;
+}
+
+/**
+ * Constant folding: a node whose inputs are all initializers is executed once by its operator and its outputs
+ * become initializers.
+ */
+static bool is_constant(connx_Graph* graph, connx_Node* node) {
+    if(node->input_count == 0) {
+        return false;
+    }
+
+    for(uint32_t i = 0; i < node->input_count; i++) {
+        if(connx_Graph_get_constant(graph, node->inputs[i]) == NULL) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Run a node on the initializers, its outputs are added to the initializers if the node is folded
+static int fold(connx_Graph* graph, connx_Context* context, connx_Node* node, bool* is_folded) {
+    for(uint32_t i = 0; i < node->input_count; i++) {
+        context->value_infos[node->inputs[i]] = connx_Graph_get_constant(graph, node->inputs[i]);
+    }
+
+    int ret = node->op(context, node->output_count, node->outputs, node->input_count, node->inputs, node->attributes,
+                       node->plan);
+
+    // Inputs are borrowed from the graph
+    for(uint32_t i = 0; i < node->input_count; i++) {
+        context->value_infos[node->inputs[i]] = NULL;
+    }
+
+    // Ids of the outputs are changed by add_initializer, so the outputs are taken out first
+    connx_Tensor* outputs[node->output_count];
+    *is_folded = ret == CONNX_OK;
+    for(uint32_t i = 0; i < node->output_count; i++) {
+        outputs[i] = context->value_infos[node->outputs[i]];
+        context->value_infos[node->outputs[i]] = NULL;
+
+        if(outputs[i] == NULL) {
+            *is_folded = false;
+        }
+    }
+
+    for(uint32_t i = 0; i < node->output_count; i++) {
+        if(outputs[i] == NULL) {
+            continue;
+        }
+
+        if(*is_folded && ret == CONNX_OK) {
+            ret = add_initializer(graph, node->outputs[i], outputs[i]);
+        } else {
+            connx_Tensor_unref(outputs[i]);
+        }
+    }
+
+    return ret;
+}
+
+static int fold_constants(connx_Graph* graph) {
+    connx_Context context;
+    memset(&context, 0, sizeof(connx_Context));
+    context.graph = graph;
+    context.value_infos = connx_alloc(sizeof(connx_Tensor*) * (graph->value_info_count + 1));
+    bool* is_foldeds = connx_alloc(sizeof(bool) * (graph->node_count + 1));
+
+    int ret = CONNX_OK;
+
+    if(context.value_infos == NULL || is_foldeds == NULL) {
+        connx_error("Out of memory\n");
+        ret = CONNX_NOT_ENOUGH_MEMORY;
+        goto done;
+    }
+
+    // Nodes are in topological order, so the outputs of a folded node are initializers for its successors
+    for(uint32_t i = 0; i < graph->node_count && ret == CONNX_OK; i++) {
+        connx_Node* node = graph->nodes[i];
+
+        if(is_constant(graph, node)) {
+            ret = fold(graph, &context, node, &is_foldeds[i]);
+        }
+    }
+
+    if(ret != CONNX_OK) {
+        goto done;
+    }
+
+    remove_nodes(graph, is_foldeds);
+
+done:
+    if(context.value_infos != NULL) {
+        connx_free(context.value_infos);
+    }
+
+    if(is_foldeds != NULL) {
+        connx_free(is_foldeds);
+    }
+
+    return ret;
+}
+
+/**
+ * BatchNormalization after Conv: Y = (conv(X, W) + B - mean) * a + bias where a = scale / sqrt(var + epsilon) of each
+ * feature map, which is conv(X, W * a) + (B - mean) * a + bias. The Conv takes the scaled weights and the new bias
+ * and the BatchNormalization is removed, when the parameters are initializers and the BatchNormalization is the only
+ * consumer of the Conv. The weights are mapped read-only, so the Conv takes new initializers, and the original ones
+ * are released by remove_unused_initializers unless other nodes share them.
+ */
+TEMPLATE_START(FLOAT32, FLOAT64)
+#undef TEMPLATE_DTYPE
+#undef TEMPLATE_TYPE
+#define TEMPLATE_DTYPE FLOAT32
+#define TEMPLATE_TYPE float32_t
+static void _scale_conv_TEMPLATE_NAME(connx_Tensor* W2, connx_Tensor* B2, connx_Tensor* W, connx_Tensor* B,
+                                      connx_Tensor** params, float32_t epsilon) {
+    int32_t feature_map_count = W->shape[0];
+    int32_t unit = connx_Int32_product(W->ndim - 1, W->shape + 1);
+
+    TEMPLATE_TYPE* W2_array = W2->buffer;
+    TEMPLATE_TYPE* B2_array = B2->buffer;
+    TEMPLATE_TYPE* W_array = W->buffer;
+    TEMPLATE_TYPE* B_array = B != NULL ? B->buffer : NULL;
+    TEMPLATE_TYPE* scale_array = params[0]->buffer;
+    TEMPLATE_TYPE* bias_array = params[1]->buffer;
+    TEMPLATE_TYPE* mean_array = params[2]->buffer;
+    TEMPLATE_TYPE* var_array = params[3]->buffer;
+
+    for(int32_t i = 0; i < feature_map_count; i++) {
+        TEMPLATE_TYPE a = scale_array[i] / sqrt(var_array[i] + epsilon);
+
+        for(int32_t j = i * unit; j < (i + 1) * unit; j++) {
+            W2_array[j] = W_array[j] * a;
+        }
+
+        B2_array[i] = ((B_array != NULL ? B_array[i] : 0) - mean_array[i]) * a + bias_array[i];
+    }
+}
+TEMPLATE_END()
+
+// Whether the BatchNormalization node can be folded into the Conv conv
+static bool is_batch_normalization(connx_Graph* graph, connx_Node* conv, connx_Node* node) {
+    // Only the inference mode is prepared
+    if(strcmp(node->op_type, "BatchNormalization") != 0 || strcmp(conv->op_type, "Conv") != 0 ||
+       conv->input_count < 2 || node->input_count != 5 || node->inputs[0] != conv->outputs[0]) {
+        return false;
+    }
+
+    connx_Tensor* W = connx_Graph_get_constant(graph, conv->inputs[1]);
+    if(W == NULL || (W->dtype != CONNX_FLOAT32 && W->dtype != CONNX_FLOAT64)) {
+        return false;
+    }
+
+    if(conv->input_count >= 3) {
+        connx_Tensor* B = connx_Graph_get_constant(graph, conv->inputs[2]);
+        if(B == NULL || B->dtype != W->dtype) {
+            return false;
+        }
+    }
+
+    for(uint32_t i = 1; i < 5; i++) {
+        connx_Tensor* param = connx_Graph_get_constant(graph, node->inputs[i]);
+        if(param == NULL || param->dtype != W->dtype || param->ndim != 1 || param->shape[0] != W->shape[0]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Replace the bias and the weights, if W2 is not NULL, of the Conv conv
+static int set_conv_weights(connx_Graph* graph, connx_Node* conv, connx_Tensor* W2, connx_Tensor* B2) {
+    uint32_t* inputs = connx_alloc(sizeof(uint32_t) * 3);
+    if(inputs == NULL) {
+        if(W2 != NULL) {
+            connx_Tensor_unref(W2);
+        }
+
+        connx_Tensor_unref(B2);
+        connx_error("Out of memory\n");
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+
+    inputs[0] = conv->inputs[0];
+    inputs[1] = conv->inputs[1];
+    connx_free(conv->inputs);
+    conv->inputs = inputs;
+    conv->input_count = 3;
+
+    int ret = CONNX_OK;
+    if(W2 != NULL) {
+        ret = add_initializer(graph, ++graph->value_info_count, W2);
+        if(ret != CONNX_OK) {
+            connx_Tensor_unref(B2);
+            return ret;
+        }
+        conv->inputs[1] = graph->initializer_count;
+    }
+
+    ret = add_initializer(graph, ++graph->value_info_count, B2);
+    if(ret != CONNX_OK) {
+        return ret;
+    }
+    conv->inputs[2] = graph->initializer_count;
+
+    // The plan of Conv holds the Winograd transform of W
+    if(W2 != NULL) {
+        ret = connx_Node_set_op_type(graph, conv, conv->op_type);
+    }
+
+    return ret;
+}
+
+static int scale_conv(connx_Graph* graph, connx_Node* conv, connx_Node* node) {
+    connx_Tensor* W = connx_Graph_get_constant(graph, conv->inputs[1]);
+    connx_Tensor* B = conv->input_count >= 3 ? connx_Graph_get_constant(graph, conv->inputs[2]) : NULL;
+    connx_Tensor* params[4]; // scale, bias, mean and var
+    for(uint32_t i = 0; i < 4; i++) {
+        params[i] = connx_Graph_get_constant(graph, node->inputs[i + 1]);
+    }
+
+    float32_t epsilon = *(float32_t*)node->attributes[0];
+
+    connx_Tensor* W2 = connx_Tensor_alloc(W->dtype, W->ndim, W->shape);
+    connx_Tensor* B2 = connx_Tensor_alloc(W->dtype, 1, W->shape);
+    if(W2 == NULL || B2 == NULL) {
+        if(W2 != NULL) {
+            connx_Tensor_unref(W2);
+        }
+
+        if(B2 != NULL) {
+            connx_Tensor_unref(B2);
+        }
+
+        connx_error("Out of memory\n");
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+
+    switch(W->dtype) {
+        TEMPLATE_START(FLOAT32, FLOAT64)
+#undef TEMPLATE_DTYPE
+#undef TEMPLATE_TYPE
+#define TEMPLATE_DTYPE FLOAT32
+#define TEMPLATE_TYPE float32_t
+        case TEMPLATE_DTYPE:
+            _scale_conv_TEMPLATE_NAME(W2, B2, W, B, params, epsilon);
+            break;
+            TEMPLATE_END()
+        default:
+            break;
+    }
+
+    // Conv(X, W2, B2) produces the output of the BatchNormalization
+    return set_conv_weights(graph, conv, W2, B2);
+}
+
+/**
+ * Add of a constant which only varies along the feature maps after Conv, (1, M, 1, 1) or (M, 1, 1) for 2D, is added
+ * to the bias of the Conv. So the bias and the activation after it are done in the epilogue of the Conv.
+ */
+static bool is_bias(connx_Graph* graph, connx_Node* conv, connx_Node* node) {
+    if(strcmp(node->op_type, "Add") != 0 || strcmp(conv->op_type, "Conv") != 0 || conv->input_count < 2 ||
+       node->input_count != 2) {
+        return false;
+    }
+
+    connx_Tensor* W = connx_Graph_get_constant(graph, conv->inputs[1]);
+    if(W == NULL || (W->dtype != CONNX_FLOAT32 && W->dtype != CONNX_FLOAT64)) {
+        return false;
+    }
+
+    if(conv->input_count >= 3) {
+        connx_Tensor* B = connx_Graph_get_constant(graph, conv->inputs[2]);
+        if(B == NULL || B->dtype != W->dtype) {
+            return false;
+        }
+    }
+
+    uint32_t id = node->inputs[0] == conv->outputs[0] ? node->inputs[1] : node->inputs[0];
+    connx_Tensor* C = connx_Graph_get_constant(graph, id);
+    if(C == NULL || C->dtype != W->dtype || C->ndim > W->ndim || C->ndim < W->ndim - 1) {
+        return false;
+    }
+
+    // Y of the Conv has the same rank as W, the feature maps are the second dimension
+    for(int32_t i = 0; i < C->ndim; i++) {
+        if(C->shape[i] != (i + W->ndim - C->ndim == 1 ? W->shape[0] : 1)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static int add_bias(connx_Graph* graph, connx_Node* conv, connx_Node* node) {
+    connx_Tensor* W = connx_Graph_get_constant(graph, conv->inputs[1]);
+    connx_Tensor* B = conv->input_count >= 3 ? connx_Graph_get_constant(graph, conv->inputs[2]) : NULL;
+    uint32_t id = node->inputs[0] == conv->outputs[0] ? node->inputs[1] : node->inputs[0];
+    connx_Tensor* C = connx_Graph_get_constant(graph, id);
+
+    connx_Tensor* B2 = connx_Tensor_alloc(W->dtype, 1, W->shape);
+    if(B2 == NULL) {
+        connx_error("Out of memory\n");
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+
+    switch(W->dtype) {
+        TEMPLATE_START(FLOAT32, FLOAT64)
+#undef TEMPLATE_DTYPE
+#undef TEMPLATE_TYPE
+#define TEMPLATE_DTYPE FLOAT32
+#define TEMPLATE_TYPE float32_t
+        case TEMPLATE_DTYPE: {
+            TEMPLATE_TYPE* B2_array = B2->buffer;
+            TEMPLATE_TYPE* B_array = B != NULL ? B->buffer : NULL;
+            TEMPLATE_TYPE* C_array = C->buffer;
+
+            for(int32_t i = 0; i < W->shape[0]; i++) {
+                B2_array[i] = (B_array != NULL ? B_array[i] : 0) + C_array[i];
+            }
+            break;
+        }
+            TEMPLATE_END()
+        default:
+            break;
+    }
+
+    return set_conv_weights(graph, conv, NULL, B2);
+}
+
+// Whether the operator of the producer can take node into its plan, nothing is changed until all the pairs are found
+static bool is_fusable(connx_Graph* graph, connx_Node* producer, connx_Node* node) {
+    return producer->can_fuse != NULL && producer->can_fuse(graph, producer, node);
+}
+
+static int fuse(connx_Graph* graph, connx_Node* producer, connx_Node* node) {
+    return producer->fuse(graph, producer, node);
+}
+
+/**
+ * Merge each node accepted by is_mergeable into the producer of one of its inputs, when the node is the only consumer
+ * of the producer. merge rewrites the producer, which then produces the output of the node, and the node is removed.
+ */
+static int merge_into_producers(connx_Graph* graph, bool (*is_mergeable)(connx_Graph*, connx_Node*, connx_Node*),
+                                int (*merge)(connx_Graph*, connx_Node*, connx_Node*)) {
+    uint32_t* producers = connx_alloc(sizeof(uint32_t) * (graph->value_info_count + 1)); // node index + 1
+    uint32_t* use_counts = connx_alloc(sizeof(uint32_t) * (graph->value_info_count + 1));
+    uint32_t* targets = connx_alloc(sizeof(uint32_t) * (graph->node_count + 1)); // producer of each node to merge + 1
+    bool* is_mergeds = connx_alloc(sizeof(bool) * (graph->node_count + 1));
+
+    int ret = CONNX_OK;
+
+    if(producers == NULL || use_counts == NULL || targets == NULL || is_mergeds == NULL) {
+        connx_error("Out of memory\n");
+        ret = CONNX_NOT_ENOUGH_MEMORY;
+        goto done;
+    }
+
+    find_producers(graph, producers, use_counts);
+
+    // Find all the pairs first, the ids are changed by the new initializers. A node which is merged is not a producer
+    // to merge into in the same pass, so the pairs don't overlap.
+    for(uint32_t i = 0; i < graph->node_count; i++) {
+        connx_Node* node = graph->nodes[i];
+
+        for(uint32_t j = 0; j < node->input_count; j++) {
+            uint32_t producer = producers[node->inputs[j]];
+            if(producer == 0 || use_counts[node->inputs[j]] != 1 || is_mergeds[producer - 1]) {
+                continue;
+            }
+
+            connx_Node* target = graph->nodes[producer - 1];
+            if(target->output_count == 1 && is_mergeable(graph, target, node)) {
+                targets[i] = producer;
+                is_mergeds[i] = true;
+                break;
+            }
+        }
+    }
+
+    for(uint32_t i = 0; i < graph->node_count && ret == CONNX_OK; i++) {
+        if(targets[i] != 0) {
+            connx_Node* target = graph->nodes[targets[i] - 1];
+            ret = merge(graph, target, graph->nodes[i]);
+            target->outputs[0] = graph->nodes[i]->outputs[0];
+        }
+    }
+
+    if(ret == CONNX_OK) {
+        remove_nodes(graph, is_mergeds);
+    }
+
+done:
+    if(producers != NULL) {
+        connx_free(producers);
+    }
+
+    if(use_counts != NULL) {
+        connx_free(use_counts);
+    }
+
+    if(targets != NULL) {
+        connx_free(targets);
+    }
+
+    if(is_mergeds != NULL) {
+        connx_free(is_mergeds);
+    }
+
+    return ret;
+}
+
+/**
+ * Mish which is expanded by the exporter, Mul(x, Tanh(Log(Add(Exp(x), 1)))), is rewritten into one Mish node. The Exp
+ * node becomes the Mish which produces the output of the Mul and the other nodes are removed, so the four passes and
+ * the three temporaries become one pass. A Conv before it takes the Mish into the epilogue later.
+ */
+
+// Index of the node which produces value_info id for the node only, if its operator is op_type, or -1
+static int32_t get_single_producer(connx_Graph* graph, uint32_t* producers, uint32_t* use_counts, uint32_t id,
+                                   char* op_type) {
+    uint32_t producer = producers[id];
+    if(producer == 0 || use_counts[id] != 1 || graph->nodes[producer - 1]->output_count != 1 ||
+       strcmp(graph->nodes[producer - 1]->op_type, op_type) != 0) {
+        return -1;
+    }
+
+    return producer - 1;
+}
+
+// Whether value_info id is a constant of one element, 1, which doesn't broadcast x to another rank
+static bool is_one(connx_Graph* graph, uint32_t* producers, uint32_t id, uint32_t x) {
+    connx_Tensor* one = connx_Graph_get_constant(graph, id);
+    if(one == NULL || connx_Int32_product(one->ndim, one->shape) != 1) {
+        return false;
+    }
+
+    switch(one->dtype) {
+        case CONNX_FLOAT32:
+            if(*(float32_t*)one->buffer != 1) {
+                return false;
+            }
+            break;
+        case CONNX_FLOAT64:
+            if(*(float64_t*)one->buffer != 1) {
+                return false;
+            }
+            break;
+        default:
+            return false;
+    }
+
+    if(one->ndim <= 1) {
+        return true;
+    }
+
+    // The rank of x is known before inference when it is the output of a Conv, the rank of its weights
+    connx_Node* producer = producers[x] != 0 ? graph->nodes[producers[x] - 1] : NULL;
+    if(producer != NULL && strcmp(producer->op_type, "Conv") == 0 && producer->input_count >= 2) {
+        connx_Tensor* W = connx_Graph_get_constant(graph, producer->inputs[1]);
+        return W != NULL && one->ndim <= W->ndim;
+    }
+
+    return false;
+}
+
+// Match the pattern which ends with mul, indices of the Exp, Add, Log and Tanh nodes are written to matches
+static bool match_mish(connx_Graph* graph, uint32_t* producers, uint32_t* use_counts, connx_Node* mul,
+                       int32_t* matches) {
+    for(uint32_t i = 0; i < 2; i++) {
+        uint32_t x = mul->inputs[i];
+
+        int32_t tanh = get_single_producer(graph, producers, use_counts, mul->inputs[1 - i], "Tanh");
+        if(tanh < 0) {
+            continue;
+        }
+
+        int32_t log = get_single_producer(graph, producers, use_counts, graph->nodes[tanh]->inputs[0], "Log");
+        if(log < 0) {
+            continue;
+        }
+
+        int32_t add = get_single_producer(graph, producers, use_counts, graph->nodes[log]->inputs[0], "Add");
+        if(add < 0 || graph->nodes[add]->input_count != 2) {
+            continue;
+        }
+
+        for(uint32_t j = 0; j < 2; j++) {
+            uint32_t* inputs = graph->nodes[add]->inputs;
+
+            int32_t exp = get_single_producer(graph, producers, use_counts, inputs[j], "Exp");
+            if(exp >= 0 && graph->nodes[exp]->inputs[0] == x && is_one(graph, producers, inputs[1 - j], x)) {
+                matches[0] = exp;
+                matches[1] = add;
+                matches[2] = log;
+                matches[3] = tanh;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+static int rewrite_mishes(connx_Graph* graph) {
+    uint32_t* producers = connx_alloc(sizeof(uint32_t) * (graph->value_info_count + 1)); // node index + 1
+    uint32_t* use_counts = connx_alloc(sizeof(uint32_t) * (graph->value_info_count + 1));
+    bool* is_removeds = connx_alloc(sizeof(bool) * (graph->node_count + 1));
+
+    int ret = CONNX_OK;
+
+    if(producers == NULL || use_counts == NULL || is_removeds == NULL) {
+        connx_error("Out of memory\n");
+        ret = CONNX_NOT_ENOUGH_MEMORY;
+        goto done;
+    }
+
+    find_producers(graph, producers, use_counts);
+
+    for(uint32_t i = 0; i < graph->node_count && ret == CONNX_OK; i++) {
+        connx_Node* node = graph->nodes[i];
+
+        int32_t matches[4]; // Exp, Add, Log and Tanh
+        if(strcmp(node->op_type, "Mul") != 0 || node->input_count != 2 ||
+           !match_mish(graph, producers, use_counts, node, matches)) {
+            continue;
+        }
+
+        connx_Node* mish = graph->nodes[matches[0]];
+        ret = connx_Node_set_op_type(graph, mish, "Mish");
+        if(ret == CONNX_NOT_SUPPORTED_OPERATOR) { // Mish is not in the opset
+            ret = CONNX_OK;
+            break;
+        }
+
+        mish->outputs[0] = node->outputs[0];
+
+        is_removeds[matches[1]] = true;
+        is_removeds[matches[2]] = true;
+        is_removeds[matches[3]] = true;
+        is_removeds[i] = true;
+    }
+
+    if(ret == CONNX_OK) {
+        remove_nodes(graph, is_removeds);
+    }
+
+done:
+    if(producers != NULL) {
+        connx_free(producers);
+    }
+
+    if(use_counts != NULL) {
+        connx_free(use_counts);
+    }
+
+    if(is_removeds != NULL) {
+        connx_free(is_removeds);
+    }
+
+    return ret;
+}
+
+/**
+ * Elementwise fusion: a group of elementwise nodes whose intermediate values are used only in the group is fused into
+ * one Elementwise node which runs the group block by block. A node joins the group of the only consumer of its output,
+ * so a group is a tree which ends with its last node, which becomes the Elementwise node.
+ */
+static struct {
+    char* op_type;
+    connx_ElementwiseOp op;
+    uint32_t input_count;
+} ELEMENTWISES[] = {
+    {"Add", CONNX_ELEMENTWISE_ADD, 2},
+    {"Sub", CONNX_ELEMENTWISE_SUB, 2},
+    {"Mul", CONNX_ELEMENTWISE_MUL, 2},
+    {"Relu", CONNX_ELEMENTWISE_RELU, 1},
+    {"LeakyRelu", CONNX_ELEMENTWISE_LEAKY_RELU, 1},
+    {"Sigmoid", CONNX_ELEMENTWISE_SIGMOID, 1},
+    {"Asin", CONNX_ELEMENTWISE_ASIN, 1},
+    {"Exp", CONNX_ELEMENTWISE_EXP, 1},
+    {"Log", CONNX_ELEMENTWISE_LOG, 1},
+    {"Tanh", CONNX_ELEMENTWISE_TANH, 1},
+    {"Mish", CONNX_ELEMENTWISE_MISH, 1},
+};
+
+// Index of the node in ELEMENTWISES, or -1
+static int32_t find_elementwise(connx_Node* node) {
+    for(uint32_t i = 0; i < sizeof(ELEMENTWISES) / sizeof(ELEMENTWISES[0]); i++) {
+        if(strcmp(node->op_type, ELEMENTWISES[i].op_type) == 0) {
+            return node->input_count == ELEMENTWISES[i].input_count && node->output_count == 1 ? (int32_t)i : -1;
+        }
+    }
+
+    return -1;
+}
+
+// Make the root node the Elementwise node of its group of size nodes, registers is zeroed scratch of each value_info
+static int fuse_group(connx_Graph* graph, uint32_t* roots, uint32_t* producers, uint32_t* registers, uint32_t root,
+                      uint32_t size, bool* is_fuseds) {
+    connx_ElementwisePlan* plan =
+        connx_alloc(sizeof(connx_ElementwisePlan) + sizeof(connx_ElementwiseInstruction) * size);
+    uint32_t* inputs = connx_alloc(sizeof(uint32_t) * size * 2); // 2 inputs of each node at most
+    if(plan == NULL || inputs == NULL) {
+        if(plan != NULL) {
+            connx_free(plan);
+        }
+
+        if(inputs != NULL) {
+            connx_free(inputs);
+        }
+
+        connx_error("Out of memory\n");
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+
+    // The inputs from outside of the group take the first registers, register + 1 is kept in registers
+    uint32_t input_count = 0;
+    for(uint32_t i = 0; i <= root; i++) {
+        if(roots[i] != root) {
+            continue;
+        }
+
+        connx_Node* node = graph->nodes[i];
+        for(uint32_t j = 0; j < node->input_count; j++) {
+            uint32_t id = node->inputs[j];
+            uint32_t producer = producers[id];
+
+            if((producer == 0 || roots[producer - 1] != root) && registers[id] == 0) {
+                inputs[input_count++] = id;
+                registers[id] = input_count;
+            }
+        }
+    }
+
+    for(uint32_t i = 0; i <= root; i++) {
+        if(roots[i] != root) {
+            continue;
+        }
+
+        connx_Node* node = graph->nodes[i];
+        connx_ElementwiseInstruction* instruction = &plan->instructions[plan->count++];
+
+        instruction->op = ELEMENTWISES[find_elementwise(node)].op;
+        instruction->a = registers[node->inputs[0]] - 1;
+        instruction->b = node->input_count > 1 ? registers[node->inputs[1]] - 1 : 0;
+        if(instruction->op == CONNX_ELEMENTWISE_LEAKY_RELU) {
+            instruction->alpha = *(float32_t*)node->attributes[0];
+        }
+
+        registers[node->outputs[0]] = input_count + plan->count;
+    }
+
+    for(uint32_t i = 0; i <= root; i++) {
+        if(roots[i] == root) {
+            registers[graph->nodes[i]->outputs[0]] = 0;
+        }
+    }
+
+    for(uint32_t i = 0; i < input_count; i++) {
+        registers[inputs[i]] = 0;
+    }
+
+    connx_Node* node = graph->nodes[root];
+    int ret = connx_Node_set_op_type(graph, node, "Elementwise");
+    if(ret != CONNX_OK) {
+        connx_free(plan);
+        connx_free(inputs);
+        return ret;
+    }
+
+    node->plan = plan;
+    connx_free(node->inputs);
+    node->inputs = inputs;
+    node->input_count = input_count;
+
+    for(uint32_t i = 0; i < root; i++) {
+        if(roots[i] == root) {
+            is_fuseds[i] = true;
+        }
+    }
+
+    return CONNX_OK;
+}
+
+static int fuse_elementwises(connx_Graph* graph) {
+    uint32_t* producers = connx_alloc(sizeof(uint32_t) * (graph->value_info_count + 1)); // node index + 1
+    uint32_t* use_counts = connx_alloc(sizeof(uint32_t) * (graph->value_info_count + 1));
+    uint32_t* consumers = connx_alloc(sizeof(uint32_t) * (graph->value_info_count + 1)); // node index + 1
+    uint32_t* registers = connx_alloc(sizeof(uint32_t) * (graph->value_info_count + 1));
+    uint32_t* roots = connx_alloc(sizeof(uint32_t) * (graph->node_count + 1)); // last node of the group
+    uint32_t* sizes = connx_alloc(sizeof(uint32_t) * (graph->node_count + 1)); // node count of the group
+    bool* is_fuseds = connx_alloc(sizeof(bool) * (graph->node_count + 1));
+
+    int ret = CONNX_OK;
+
+    if(producers == NULL || use_counts == NULL || consumers == NULL || registers == NULL || roots == NULL ||
+       sizes == NULL || is_fuseds == NULL) {
+        connx_error("Out of memory\n");
+        ret = CONNX_NOT_ENOUGH_MEMORY;
+        goto done;
+    }
+
+    find_producers(graph, producers, use_counts);
+
+    for(uint32_t i = 0; i < graph->node_count; i++) {
+        connx_Node* node = graph->nodes[i];
+
+        for(uint32_t j = 0; j < node->input_count; j++) {
+            consumers[node->inputs[j]] = i + 1;
+        }
+    }
+
+    // The consumers come later in the model order, so their groups are known
+    for(uint32_t i = graph->node_count; i-- > 0;) {
+        connx_Node* node = graph->nodes[i];
+        roots[i] = i;
+
+        if(find_elementwise(node) < 0) {
+            continue;
+        }
+
+        uint32_t id = node->outputs[0];
+        uint32_t consumer = consumers[id];
+        if(use_counts[id] == 1 && consumer != 0 && find_elementwise(graph->nodes[consumer - 1]) >= 0) {
+            roots[i] = roots[consumer - 1];
+        }
+
+        sizes[roots[i]]++;
+    }
+
+    for(uint32_t i = 0; i < graph->node_count && ret == CONNX_OK; i++) {
+        if(roots[i] == i && sizes[i] > 1) {
+            ret = fuse_group(graph, roots, producers, registers, i, sizes[i], is_fuseds);
+        }
+    }
+
+    // Elementwise is not in the opset
+    if(ret == CONNX_NOT_SUPPORTED_OPERATOR) {
+        ret = CONNX_OK;
+    }
+
+    if(ret == CONNX_OK) {
+        remove_nodes(graph, is_fuseds);
+    }
+
+done:
+    if(producers != NULL) {
+        connx_free(producers);
+    }
+
+    if(use_counts != NULL) {
+        connx_free(use_counts);
+    }
+
+    if(consumers != NULL) {
+        connx_free(consumers);
+    }
+
+    if(registers != NULL) {
+        connx_free(registers);
+    }
+
+    if(roots != NULL) {
+        connx_free(roots);
+    }
+
+    if(sizes != NULL) {
+        connx_free(sizes);
+    }
+
+    if(is_fuseds != NULL) {
+        connx_free(is_fuseds);
+    }
+
+    return ret;
+}
+
+int connx_Graph_optimize(connx_Graph* graph) {
+    int ret = fold_constants(graph);
+    if(ret == CONNX_OK) {
+        ret = merge_into_producers(graph, is_batch_normalization, scale_conv);
+    }
+
+    if(ret == CONNX_OK) {
+        ret = merge_into_producers(graph, is_bias, add_bias);
+    }
+
+    if(ret == CONNX_OK) {
+        ret = rewrite_mishes(graph);
+    }
+
+    // Activations are fused after the bias is folded, the epilogue of Conv adds the bias before the activation
+    if(ret == CONNX_OK) {
+        ret = merge_into_producers(graph, is_fusable, fuse);
+    }
+
+    // What is left after the Conv epilogues
+    if(ret == CONNX_OK) {
+        ret = fuse_elementwises(graph);
+    }
+
+    if(ret == CONNX_OK) {
+        ret = remove_unused_initializers(graph);
+    }
+
+    return ret;
+}
@@ -0,0 +1,344 @@
+#include <stdlib.h> // qsort
+#include <string.h>
+#include <connx/connx.h>
+#include <connx/hal.h>
+
+/**
+ * Activation memory planner
+ *
+ * Every value_info produced by a node is alive from the node which produces it until all the nodes which consume
+ * it are executed. Nodes run in any order the dependency DAG allows, so two buffers can share the same region of
+ * the arena only when one of them is produced by a node which depends on every consumer of the other one.
+ * Reshape returns a view of its input, so the view and its input share one buffer (root) which is alive for both
+ * of them. Graph inputs, initializers and graph outputs (and the buffers they view) are not planned.
+ *
+ * Buffer sizes are not known until the operators run, so the sizes are recorded by connx_Context_alloc and the
+ * plan is rebuilt after a run whenever a buffer did not fit in its slot. Each context takes a copy of the slots and
+ * offsets at the beginning of a run, so a rebuilt plan never moves the buffers of a running context.
+ */
+static bool is_view(connx_Node* node) {
+    return strcmp(node->op_type, "Reshape") == 0;
+}
+
+/**
+ * Operators which compute each element of the output from the elements of the same index of the inputs, with the
+ * number of the first inputs which can have the shape of the output, 0 for all of them. The parameters of
+ * BatchNormalization are vectors of the channels while X has the channels and the batch at least.
+ */
+static struct {
+    char* op_type;
+    uint32_t input_count;
+} INPLACES[] = {
+    {"Add", 0},
+    {"Asin", 0},
+    {"BatchNormalization", 1},
+    {"Elementwise", 0},
+    {"Exp", 0},
+    {"LeakyRelu", 0},
+    {"Log", 0},
+    {"Mish", 0},
+    {"Mul", 0},
+    {"Relu", 0},
+    {"Sigmoid", 0},
+    {"Sub", 0},
+    {"Tanh", 0},
+};
+
+// Number of the first inputs which the node may overwrite with its output
+static uint32_t get_inplace_count(connx_Node* node) {
+    for(uint32_t i = 0; i < sizeof(INPLACES) / sizeof(INPLACES[0]); i++) {
+        if(strcmp(node->op_type, INPLACES[i].op_type) == 0) {
+            uint32_t count = INPLACES[i].input_count;
+            return count == 0 || count > node->input_count ? node->input_count : count;
+        }
+    }
+
+    return 0;
+}
+
+// Whether the buffer of root id is not used anymore when the node runs
+static bool is_free(connx_Plan* plan, uint32_t id, int32_t node) {
+    uint32_t* frees = plan->frees + id * plan->word_count;
+    return (frees[node / 32] >> (node % 32)) & 1;
+}
+
+int connx_Plan_init(connx_Plan* plan, connx_Graph* graph) {
+    uint32_t count = graph->value_info_count + 1; // 0 is null
+    uint32_t word_count = (graph->node_count + 31) / 32;
+
+    plan->value_count = count;
+    plan->word_count = word_count;
+    plan->roots = connx_alloc(sizeof(uint32_t) * count);
+    plan->begins = connx_alloc(sizeof(int32_t) * count);
+    // Bit sets of the nodes take no words when the graph has no nodes, one more word keeps the size non-zero
+    plan->frees = connx_alloc(sizeof(uint32_t) * (word_count * count + 1));
+    plan->sizes = connx_alloc(sizeof(uint32_t) * count);
+    plan->slots = connx_alloc(sizeof(uint32_t) * count);
+    plan->offsets = connx_alloc(sizeof(uint32_t) * count);
+    plan->inplace_offsets = connx_alloc(sizeof(uint32_t) * (graph->node_count + 1));
+
+    uint32_t input_count = 0;
+    for(uint32_t i = 0; i < graph->node_count; i++) {
+        input_count += graph->nodes[i]->input_count;
+    }
+    plan->inplaces = connx_alloc(sizeof(uint32_t) * (input_count + 1));
+
+    // Descendants of each node in the DAG, one more word as frees
+    uint32_t* reaches = connx_alloc(sizeof(uint32_t) * (word_count * graph->node_count + 1));
+
+    if(plan->roots == NULL || plan->begins == NULL || plan->frees == NULL || plan->sizes == NULL ||
+       plan->slots == NULL || plan->offsets == NULL || plan->inplace_offsets == NULL || plan->inplaces == NULL ||
+       reaches == NULL) {
+        if(reaches != NULL) {
+            connx_free(reaches);
+        }
+
+        connx_error("Out of memory\n");
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+
+    for(uint32_t i = 0; i < graph->node_count; i++) {
+        connx_Node* node = graph->nodes[i];
+
+        for(uint32_t j = 0; j < node->output_count; j++) {
+            uint32_t id = node->outputs[j];
+
+            plan->begins[id] = i;
+            plan->roots[id] = id;
+        }
+
+        if(is_view(node)) {
+            plan->roots[node->outputs[0]] = plan->roots[node->inputs[0]];
+        }
+    }
+
+    // Successors come after their predecessors, so the descendants are collected backward
+    for(uint32_t i = graph->node_count; i-- > 0;) {
+        uint32_t* reach = reaches + i * word_count;
+
+        for(uint32_t j = graph->successor_offsets[i]; j < graph->successor_offsets[i + 1]; j++) {
+            uint32_t successor = graph->successors[j];
+            uint32_t* successor_reach = reaches + successor * word_count;
+
+            reach[successor / 32] |= 1U << (successor % 32);
+            for(uint32_t k = 0; k < word_count; k++) {
+                reach[k] |= successor_reach[k];
+            }
+        }
+    }
+
+    // A buffer is free at the nodes which descend from its producer and all of its consumers (views included)
+    for(uint32_t id = 1; id < count; id++) {
+        if(plan->roots[id] == id) {
+            memcpy(plan->frees + id * word_count, reaches + plan->begins[id] * word_count,
+                   sizeof(uint32_t) * word_count);
+        }
+    }
+
+    for(uint32_t i = 0; i < graph->node_count; i++) {
+        connx_Node* node = graph->nodes[i];
+        uint32_t* reach = reaches + i * word_count;
+
+        for(uint32_t j = 0; j < node->input_count; j++) {
+            uint32_t root = plan->roots[node->inputs[j]];
+            if(root != 0) {
+                uint32_t* frees = plan->frees + root * word_count;
+                for(uint32_t k = 0; k < word_count; k++) {
+                    frees[k] &= reach[k];
+                }
+            }
+        }
+    }
+
+    connx_free(reaches);
+
+    // Graph outputs are returned to the caller, so they cannot live in the arena
+    for(uint32_t i = 0; i < graph->output_count; i++) {
+        uint32_t root = plan->roots[graph->outputs[i]];
+        if(root != 0) {
+            plan->roots[root] = 0;
+        }
+    }
+
+    for(uint32_t id = 1; id < count; id++) {
+        if(plan->roots[plan->roots[id]] == 0) {
+            plan->roots[id] = 0;
+        }
+    }
+
+    plan->roots[0] = 0;
+
+    /**
+     * A node may write its output over an input which only it consumes, then the buffer of the input is kept until
+     * the output is not used anymore. Which input has the shape of the output is known only when the node runs, e.g.
+     * the other one is broadcast, so all of them are candidates. The output keeps its own root for the runs which
+     * cannot do it in place.
+     */
+    input_count = 0;
+    for(uint32_t i = 0; i < graph->node_count; i++) {
+        connx_Node* node = graph->nodes[i];
+        uint32_t output = node->outputs[0];
+        uint32_t count = plan->roots[output] == output ? get_inplace_count(node) : 0;
+
+        plan->inplace_offsets[i] = input_count;
+        for(uint32_t j = 0; j < count; j++) {
+            uint32_t id = node->inputs[j];
+
+            if(plan->roots[id] == id && id != 0 && graph->use_counts[id] == 1) {
+                plan->inplaces[input_count++] = id;
+            }
+        }
+    }
+    plan->inplace_offsets[graph->node_count] = input_count;
+
+    // Nodes are visited backward, so a chain of them ends up in the buffer of the first input
+    for(uint32_t i = graph->node_count; i-- > 0;) {
+        uint32_t* output_frees = plan->frees + graph->nodes[i]->outputs[0] * word_count;
+
+        for(uint32_t j = plan->inplace_offsets[i]; j < plan->inplace_offsets[i + 1]; j++) {
+            uint32_t* frees = plan->frees + plan->inplaces[j] * word_count;
+            for(uint32_t k = 0; k < word_count; k++) {
+                frees[k] &= output_frees[k];
+            }
+        }
+    }
+
+    return CONNX_OK;
+}
+
+int connx_Plan_destroy(connx_Plan* plan) {
+    if(plan->roots != NULL) {
+        connx_free(plan->roots);
+    }
+
+    if(plan->begins != NULL) {
+        connx_free(plan->begins);
+    }
+
+    if(plan->frees != NULL) {
+        connx_free(plan->frees);
+    }
+
+    if(plan->sizes != NULL) {
+        connx_free(plan->sizes);
+    }
+
+    if(plan->slots != NULL) {
+        connx_free(plan->slots);
+    }
+
+    if(plan->offsets != NULL) {
+        connx_free(plan->offsets);
+    }
+
+    if(plan->inplace_offsets != NULL) {
+        connx_free(plan->inplace_offsets);
+    }
+
+    if(plan->inplaces != NULL) {
+        connx_free(plan->inplaces);
+    }
+
+    return CONNX_OK;
+}
+
+typedef struct _Block {
+    uint32_t id;
+    uint32_t offset;
+    uint32_t size;
+} Block;
+
+static int compare_size(const void* a, const void* b) {
+    const Block* x = a;
+    const Block* y = b;
+
+    if(x->size != y->size) {
+        return x->size > y->size ? -1 : 1; // descending order
+    }
+
+    return x->id < y->id ? -1 : x->id > y->id ? 1 : 0;
+}
+
+static int compare_offset(const void* a, const void* b) {
+    const Block* x = a;
+    const Block* y = b;
+
+    return x->offset < y->offset ? -1 : x->offset > y->offset ? 1 : 0;
+}
+
+/**
+ * Place the buffers from the largest one, each into the smallest gap between the already placed buffers
+ * which can be alive at the same time (best-fit).
+ */
+int connx_Plan_update(connx_Plan* plan) {
+    uint32_t count = 0;
+    Block* blocks = connx_alloc(sizeof(Block) * plan->value_count * 2);
+    if(blocks == NULL) {
+        connx_error("Out of memory\n");
+        return CONNX_NOT_ENOUGH_MEMORY;
+    }
+
+    plan->total_size = 0;
+    for(uint32_t id = 1; id < plan->value_count; id++) {
+        if(plan->roots[id] == id && plan->sizes[id] > 0) {
+            blocks[count].id = id;
+            blocks[count].offset = 0;
+            blocks[count].size = CONNX_ALIGN(plan->sizes[id]);
+            plan->total_size += blocks[count].size;
+            count++;
+        }
+    }
+
+    qsort(blocks, count, sizeof(Block), compare_size);
+
+    Block* alive = blocks + plan->value_count; // placed blocks which overlap the current one
+    plan->arena_size = 0;
+
+    for(uint32_t i = 0; i < count; i++) {
+        Block* block = &blocks[i];
+
+        uint32_t alive_count = 0;
+        for(uint32_t j = 0; j < i; j++) {
+            uint32_t id = blocks[j].id;
+            if(!is_free(plan, id, plan->begins[block->id]) && !is_free(plan, block->id, plan->begins[id])) {
+                alive[alive_count++] = blocks[j];
+            }
+        }
+
+        qsort(alive, alive_count, sizeof(Block), compare_offset);
+
+        uint32_t best_offset = UINT32_MAX;
+        uint32_t best_gap = UINT32_MAX;
+        uint32_t offset = 0;
+
+        for(uint32_t j = 0; j < alive_count; j++) {
+            if(alive[j].offset >= offset) {
+                uint32_t gap = alive[j].offset - offset;
+                if(gap >= block->size && gap < best_gap) {
+                    best_offset = offset;
+                    best_gap = gap;
+                }
+            }
+
+            if(alive[j].offset + alive[j].size > offset) {
+                offset = alive[j].offset + alive[j].size;
+            }
+        }
+
+        block->offset = best_offset != UINT32_MAX ? best_offset : offset;
+
+        plan->offsets[block->id] = block->offset;
+        plan->slots[block->id] = plan->sizes[block->id];
+
+        if(block->offset + block->size > plan->arena_size) {
+            plan->arena_size = block->offset + block->size;
+        }
+    }
+
+    connx_free(blocks);
+
+    plan->is_dirty = false;
+    plan->version++;
+
+    return CONNX_OK;
+}
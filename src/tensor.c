@@ -148,6 +148,33 @@ connx_Tensor* connx_Tensor_alloc(connx_DataType dtype, int32_t ndim, int32_t* sh
     return tensor;
 }
 
+/**
+ * Tensor payload: [connx_Tensor] [shape]
+ * The buffer is not owned by the tensor, the owner must keep it alive while the tensor is referenced
+ */
+connx_Tensor* connx_Tensor_wrap(connx_DataType dtype, int32_t ndim, int32_t* shape, void* buffer) {
+    uint32_t header_size = CONNX_ALIGN(sizeof(connx_Tensor));
+    uint32_t dim_size = CONNX_ALIGN(sizeof(int32_t) * ndim);
+
+    void* ptr = connx_alloc(header_size + dim_size);
+    if(ptr == NULL) {
+        return NULL;
+    }
+
+    connx_Tensor* tensor = ptr;
+    tensor->dtype = dtype;
+    tensor->ndim = ndim;
+    tensor->shape = ptr + header_size;
+    memcpy(tensor->shape, shape, sizeof(int32_t) * ndim);
+    tensor->buffer = buffer;
+    tensor->size = connx_DataType_size(dtype) * connx_Int32_product(ndim, shape);
+    tensor->parent = NULL;
+    tensor->ref_count = 1;
+    connx_Lock_init(&tensor->lock);
+
+    return tensor;
+}
+
 connx_Tensor* connx_Tensor_alloc_like(connx_Tensor* tensor) {
     return connx_Tensor_alloc(tensor->dtype, tensor->ndim, tensor->shape);
 }
@@ -198,6 +225,9 @@ connx_Tensor* connx_Tensor_alloc_buffer(void* buf) {
         strtol(number, NULL, 0);          \
     })
 
+// Bytes copied by connx_Tensor_copy, for the statistics
+static uint64_t copied_bytes;
+
 connx_Tensor* connx_Tensor_copy(connx_Tensor* tensor) {
     connx_Tensor* tensor2 = connx_Tensor_alloc_like(tensor);
     if(tensor2 == NULL)
@@ -206,10 +236,15 @@ connx_Tensor* connx_Tensor_copy(connx_Tensor* tensor) {
     int32_t total = connx_Int32_product(tensor->ndim, tensor->shape);
     int32_t data_size = connx_DataType_size(tensor->dtype);
     memcpy(tensor2->buffer, tensor->buffer, total * data_size);
+    __atomic_fetch_add(&copied_bytes, (uint64_t)total * data_size, __ATOMIC_RELAXED);
 
     return tensor2;
 }
 
+uint64_t connx_Tensor_copied_bytes() {
+    return __atomic_load_n(&copied_bytes, __ATOMIC_RELAXED);
+}
+
 connx_Tensor* connx_Tensor_reshape(connx_Tensor* tensor, int32_t ndim, int32_t* shape) {
     uint32_t header_size = CONNX_ALIGN(sizeof(connx_Tensor));
     uint32_t dim_size = CONNX_ALIGN(sizeof(int32_t) * ndim);